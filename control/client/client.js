@@ -26,6 +26,8 @@ class WateringClient {
     document.getElementById('checkNowButton').onclick = this.apiCheckNow;
     document.getElementById('pingButton').onclick = this.apiPing;
     document.getElementById('pollButton').onclick = this.apiPoll;
+    document.getElementById('diagnosticsButton').onclick = this.apiGetDiagnostics;
+    document.getElementById('historyButton').onclick = this.apiGetHistory;
     document.getElementById('connectButton').onclick = this.apiConnect;
     document.getElementById('disconnectButton').onclick = this.apiDisconnect;
     document.getElementById('getSettingsButton').onclick = this.apiGetSettings;
@@ -129,6 +131,37 @@ class WateringClient {
           document.getElementById('delayAfterSend').disabled = true;
         }
 
+        // diagnostics and extended settings only available in >= v2.4.0
+        const extSupported = checkVersionGe(this.softwareVersion, '2.4.0');
+        document.getElementById('diagnosticsButton').disabled = !extSupported;
+        document.getElementById('historyButton').disabled = !extSupported;
+        document.getElementById('adcOversampling').disabled = !extSupported;
+        document.getElementById('adcFilterType').disabled = !extSupported;
+        document.getElementById('adcFilterDepth').disabled = !extSupported;
+        document.getElementById('pushOnChange').disabled = !extSupported;
+        document.getElementById('deadbandAdc').disabled = !extSupported;
+        document.getElementById('deadbandTemp').disabled = !extSupported;
+        document.getElementById('deadbandBattery').disabled = !extSupported;
+        document.getElementById('heartbeatInterval').disabled = !extSupported;
+        document.getElementById('valveOrder').disabled = !extSupported;
+        document.getElementById('valveMax').disabled = !extSupported;
+        document.getElementById('valveGap').disabled = !extSupported;
+        document.getElementById('checkAdaptive').disabled = !extSupported;
+        document.getElementById('checkIntervalMin').disabled = !extSupported;
+        document.getElementById('checkIntervalMax').disabled = !extSupported;
+        document.getElementById('sensorsWarmup').disabled = !extSupported;
+        document.getElementById('settleTolerance').disabled = !extSupported;
+        document.getElementById('routeVia').disabled = !extSupported;
+
+        // channels not available at the watering system
+        for (let i = 0; i < 4; i++) {
+          const available = i < info.channelCount;
+          document.getElementById('channelEnabled' + i).disabled = !available;
+          document.getElementById('adcTriggerValue' + i).disabled = !available;
+          document.getElementById('wateringTime' + i).disabled = !available;
+          document.getElementById('onoff' + i).disabled = !available;
+        }
+
         // temperature switch only available in >= v2.2.0
         if (checkVersionGe(this.softwareVersion, '2.2.0')) {
           document.getElementById('tempSwitchTriggerValue').disabled = false;
@@ -181,6 +214,33 @@ class WateringClient {
             document.getElementById('tempSwitchHyst').value = 0;
             document.getElementById('tempSwitchInverted').checked = false;
           }
+          if (checkVersionGe(this.softwareVersion, '2.4.0') && info.settings.adcOversampling !== undefined) {
+            document.getElementById('adcOversampling').value = info.settings.adcOversampling;
+            document.getElementById('adcFilterType').value = info.settings.adcFilterType;
+            document.getElementById('adcFilterDepth').value = info.settings.adcFilterDepth;
+            document.getElementById('pushOnChange').checked = info.settings.pushOnChange;
+            document.getElementById('deadbandAdc').value = info.settings.deadbandAdc;
+            document.getElementById('deadbandTemp').value = info.settings.deadbandTemp;
+            document.getElementById('deadbandBattery').value = info.settings.deadbandBattery;
+            document.getElementById('heartbeatInterval').value = info.settings.heartbeatInterval;
+            if (info.settings.valveMax !== undefined) {
+              document.getElementById('valveOrder').value = info.settings.valveOrder;
+              document.getElementById('valveMax').value = info.settings.valveMax;
+              document.getElementById('valveGap').value = info.settings.valveGap;
+            }
+            if (info.settings.checkAdaptive !== undefined) {
+              document.getElementById('checkAdaptive').checked = info.settings.checkAdaptive;
+              document.getElementById('checkIntervalMin').value = info.settings.checkIntervalMin;
+              document.getElementById('checkIntervalMax').value = info.settings.checkIntervalMax;
+            }
+            if (info.settings.sensorsWarmup !== undefined) {
+              document.getElementById('sensorsWarmup').value = info.settings.sensorsWarmup;
+              document.getElementById('settleTolerance').value = info.settings.settleTolerance;
+            }
+            if (info.settings.routeVia !== undefined) {
+              document.getElementById('routeVia').value = info.settings.routeVia;
+            }
+          }
         }
       } else {
         document.getElementById('settings').style.display = 'none';
@@ -188,7 +248,7 @@ class WateringClient {
         document.getElementById('saveSettingsButton').style.display = 'none';
       }
 
-      for (let i = 0; i < 4; i++) {
+      for (let i = 0; i < Math.min(info.channelCount, 4); i++) {
         document.getElementById('onoff' + i).innerHTML = info.status.on[i] ? this.i18n.__('on') : this.i18n.__('off');
         document.getElementById('onoff' + i).dataset.translate = info.status.on[i] ? 'on' : 'off';
         if (info.status.on[i]) {
@@ -202,6 +262,14 @@ class WateringClient {
       document.getElementById('humidity').innerHTML = info.status.humidity + ' %';
       document.getElementById('battery').innerHTML = info.status.batPercent + ' %';
       document.getElementById('battery2').innerHTML = info.status.batVolt + ' V (' + info.status.batRaw + ')';
+      if (info.status.memoryStats) {
+        const mem = info.status.memoryStats;
+        document.getElementById('memory').innerHTML = 'RAM ' + mem.free + ' / ' + mem.ramSize + ' B (min ' + mem.minFree + ' B)';
+        document.getElementById('memory2').innerHTML = 'Stack ' + mem.stackMax + ' B, Flash ' + mem.flashUsed + ' B';
+      } else {
+        document.getElementById('memory').innerHTML = '-';
+        document.getElementById('memory2').innerHTML = '-';
+      }
 
       if (info.status.tempSwitchOn) {
         document.getElementById('tempSwitchOn').innerHTML = this.i18n.__('on');
@@ -280,6 +348,30 @@ class WateringClient {
     });
   }
 
+  /**
+   * Method to request the diagnostic data from the watering system.
+   */
+  apiGetDiagnostics () {
+    fetch('/api/getDiagnostics')
+    .then((res) => {
+      if (res.status != 200) {
+        alert('Error! ' + res.status + '\n' + res.body);
+      }
+    });
+  }
+
+  /**
+   * Method to request the history samples from the watering system.
+   */
+  apiGetHistory () {
+    fetch('/api/getHistory')
+    .then((res) => {
+      if (res.status != 200) {
+        alert('Error! ' + res.status + '\n' + res.body);
+      }
+    });
+  }
+
   /**
    * Method to send the 'get settings' command to the watering system.
    */
@@ -326,6 +418,23 @@ class WateringClient {
         tempSwitchTriggerValue: document.getElementById('tempSwitchTriggerValue').value,
         tempSwitchHyst: document.getElementById('tempSwitchHyst').value,
         tempSwitchInverted: document.getElementById('tempSwitchInverted').checked,
+        adcOversampling: document.getElementById('adcOversampling').value,
+        adcFilterType: document.getElementById('adcFilterType').value,
+        adcFilterDepth: document.getElementById('adcFilterDepth').value,
+        pushOnChange: document.getElementById('pushOnChange').checked,
+        deadbandAdc: document.getElementById('deadbandAdc').value,
+        deadbandTemp: document.getElementById('deadbandTemp').value,
+        deadbandBattery: document.getElementById('deadbandBattery').value,
+        heartbeatInterval: document.getElementById('heartbeatInterval').value,
+        valveOrder: document.getElementById('valveOrder').value,
+        valveMax: document.getElementById('valveMax').value,
+        valveGap: document.getElementById('valveGap').value,
+        checkAdaptive: document.getElementById('checkAdaptive').checked,
+        checkIntervalMin: document.getElementById('checkIntervalMin').value,
+        checkIntervalMax: document.getElementById('checkIntervalMax').value,
+        sensorsWarmup: document.getElementById('sensorsWarmup').value,
+        settleTolerance: document.getElementById('settleTolerance').value,
+        routeVia: document.getElementById('routeVia').value,
       }),
       headers: {
         'content-type': 'application/json'
@@ -433,7 +542,8 @@ class WateringClient {
         port: document.getElementById('port').value,
         baud: document.getElementById('baud').value,
         addressThis: document.getElementById('addressThis').value,
-        addressClient: document.getElementById('addressClient').value
+        addressClient: document.getElementById('addressClient').value,
+        routeVia: document.getElementById('connectRouteVia').value
       }),
       headers: {
         'content-type': 'application/json'
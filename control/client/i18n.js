@@ -106,12 +106,16 @@ const translations = {
     addressOfWateringSystem: 'Adress des Bewässerungssystems',
     '0x01or1': '0x01 oder 1',
     '0xDCor220': '0xDC oder 220',
+    routedMode: 'Geroutet über (optional)',
+    routedModeInfo: 'Nur für Bewässerungssysteme mit <code>RH_ROUTING 1</code>.\nAdresse des Teilnehmers, über den das Bewässerungssystem erreicht wird, oder die Adresse des Bewässerungssystems selbst bei direkter Verbindung.\nLeer für den normalen Betrieb ohne Routing.',
     connect: 'Verbinden ...',
     outdatedWarning: '<strong>Warnung:</strong> Die Softwareversion des automatischen Bewässerungssystems ist veraltet! Manche Funktionen sind möglicherweise nicht verfügbar.',
     checkNow: 'Jetzt prüfen',
     sendPing: 'Ping senden',
     getSettings: 'Einstellungen vom Bewässerungssystem laden',
     pollData: 'Daten pollen',
+    getDiagnostics: 'Diagnosedaten abfragen',
+    getHistory: 'Verlauf abfragen',
     disconnect: 'Verbindung trennen',
     channel: 'Kanal',
     active: 'Aktiv',
@@ -137,6 +141,30 @@ const translations = {
     temperatureSwitchHysteresisInfo: 'Hysterese für den temperaturabhängigen Schalter.\nDieser Wert zur Ermittlung der Schaltschwellen zusammen mit dem Triggerwert verwendet, um ein häufiges Ein- und Ausschalten zu verhindern.\nDie Hysterese kann in 0,1-er Schritten angegeben werden.\nMinimum: <code>0,0</code>, Maximum: <code>25,0</code>',
     temperatureSwitchInverted: 'Temperaturschalter umgekehrt',
     temperatureSwitchInvertedInfo: 'Standardmäßig wird der temperaturabhängige Schalter beim Überschreiten der eingestellten Temperatur eingeschaltet und beim Unterschreiten ausgeschaltet.\nDurch das Invertieren wird der Schalter beim Unterschreiten der eingestellten Temperatur eingeschaltet und beim Überschreiten ausgeschaltet.',
+    adcOversampling: 'ADC-Messungen pro Prüfung',
+    adcOversamplingInfo: 'Anzahl der ADC-Messungen pro Kanal und Prüfung, aus denen der Mittelwert gebildet wird.\nMinimum: <code>1</code>, Maximum: <code>16</code>',
+    adcFilter: 'ADC-Filter',
+    adcFilterInfo: 'Filter für die gemessenen ADC-Werte, damit einzelne fehlerhafte Messungen keine Bewässerung auslösen.\nMedian: Median der letzten <i>n</i> Prüfungen (maximal 5).\nEWMA: Gleitender Mittelwert, bei dem neue Werte mit <code>1/n</code> gewichtet werden.\nMit Filter startet die Bewässerung erst nach mehreren Prüfungen über dem Auslösewert, beim Median von 3 Prüfungen nach der zweiten.',
+    adcFilterNone: 'Kein Filter',
+    adcFilterMedian: 'Median',
+    adcFilterEwma: 'EWMA',
+    pushOnChange: 'Nur Änderungen senden',
+    pushOnChangeInfo: 'Wenn aktiviert, dann werden die Messwerte nur automatisch gesendet, wenn sie sich um mehr als die Totbänder geändert haben.\nDadurch wird die Funkübertragung und der Stromverbrauch reduziert.',
+    deadbands: 'Totbänder (ADC, °C/%, Batterie %)',
+    deadbandsInfo: 'Änderungen bis zu diesen Werten werden nicht gesendet.\nADC-Werte in ADC-Schritten, Temperatur und Luftfeuchtigkeit in 0,1-er Schritten, Batterie in Prozent.',
+    heartbeatInterval: 'Lebenszeichen-Intervall',
+    heartbeatIntervalInfo: 'Wenn nur Änderungen gesendet werden, dann werden spätestens nach dieser Zeit alle Messwerte gesendet, damit ein Ausfall des Systems erkannt werden kann.\n<code>0</code> deaktiviert das Lebenszeichen.',
+    valveQueue: 'Warteschlange (Reihenfolge, max. Ventile, Pause s)',
+    valveQueueInfo: 'Kanäle, die bewässert werden sollen, warten in einer Warteschlange.\nReihenfolge: In der Reihenfolge der Anforderung oder der trockenste Kanal zuerst.\nMax. Ventile: Anzahl der Ventile, die gleichzeitig geöffnet sein dürfen.\nPause: Zeit in Sekunden nach dem Schließen eines Ventils, bevor das nächste geöffnet wird.',
+    valveOrderFifo: 'Anforderung',
+    valveOrderDriest: 'Trockenster zuerst',
+    checkAdaptive: 'Adaptives Prüfintervall (min. s, max. s)',
+    checkAdaptiveInfo: 'Wenn aktiviert, dann wird anstelle des festen Prüfintervalls ein Intervall zwischen Minimum und Maximum verwendet.\nNahe am Auslösewert, bei schnell steigenden Werten und direkt nach einer Bewässerung wird häufiger geprüft, bei stabilen Werten weit weg vom Auslösewert seltener.',
+    sensorsWarmup: 'Sensor-Aufwärmzeit (ms, Toleranz)',
+    sensorsWarmupInfo: 'Maximale Zeit in Millisekunden, die die Sensoren vor dem Lesen der Werte eingeschaltet werden.\nDie Werte werden früher gelesen, sobald sich zwei Messungen jedes Sensors um höchstens die Toleranz unterscheiden.\n<code>0</code> als Toleranz wartet immer die volle Aufwärmzeit ab.',
+    routeVia: 'Zur Zentrale über',
+    routeViaInfo: 'Nur mit <code>RH_ROUTING 1</code>.\nAdresse des Nachbarn, über den die Nachrichten an die Zentrale weitergeleitet werden.\n<code>255</code> sendet direkt an die Zentrale.',
+    '0xFFor255': '0xFF oder 255',
     sendAdcValues: 'ADC-Werte senden',
     sendAdcValuesInfo: 'Wenn aktiviert, dann werden die gemessenen ADC-Werte per RadioHead übertragen.\nWenn deaktiviert, dann werden nur die Schaltzustände der einzelnen Kanäle übertragen.',
     enableAutomaticDataPush: 'Automatisches Senden der Daten',
@@ -149,6 +177,7 @@ const translations = {
     temperature: 'Temperatur',
     humidity: 'Luftfeuchtigkeit',
     battery: 'Batterie',
+    memory: 'Speicher',
     system: 'System',
     pause: 'Pause',
     resume: 'Fortsetzen',
@@ -173,12 +202,16 @@ const translations = {
     addressOfWateringSystem: 'Address of the watering system',
     '0x01or1': '0x01 or 1',
     '0xDCor220': '0xDC or 220',
+    routedMode: 'Routed via (optional)',
+    routedModeInfo: 'Only for watering systems with <code>RH_ROUTING 1</code>.\nAddress of the node the watering system is reached through, or the address of the watering system itself for a direct connection.\nEmpty for the normal mode without routing.',
     connect: 'Connect ...',
     outdatedWarning: '<strong>Warning:</strong> The software version of the automatic watering system is outdated! Some features may not be available.',
     checkNow: 'Check now',
     sendPing: 'Send ping',
     getSettings: 'Get settings from watering system',
     pollData: 'Poll data',
+    getDiagnostics: 'Get diagnostic data',
+    getHistory: 'Get history',
     disconnect: 'Disconnect',
     channel: 'Channel',
     active: 'Active',
@@ -204,6 +237,30 @@ const translations = {
     temperatureSwitchHysteresisInfo: 'Hysteresis for the temperature-dependent switch.\nThis value is used to determine the switching thresholds together with the trigger value to prevent frequent switching on and off.\nThe hysteresis can be specified in steps of 0.1.\nMinimum: <code>0.0</code>, Maximum: <code>25.0</code>',
     temperatureSwitchInverted: 'Temperature switch inverted',
     temperatureSwitchInvertedInfo: 'By default, the temperature-dependent switch is switched on when the set temperature is exceeded and switched off when the temperature falls below.\nInverting switches the switch on when the temperature falls below the set value and switches it off when the temperature is exceeded.',
+    adcOversampling: 'ADC readings per check',
+    adcOversamplingInfo: 'Number of ADC readings per channel and check which are averaged.\nMinimum: <code>1</code>, Maximum: <code>16</code>',
+    adcFilter: 'ADC filter',
+    adcFilterInfo: 'Filter for the measured ADC values to prevent single faulty readings from triggering the watering.\nMedian: Median of the last <i>n</i> checks (max 5).\nEWMA: Moving average where new values are weighted with <code>1/n</code>.\nWith a filter the watering starts only after multiple checks above the trigger value, with the median of 3 checks after the second one.',
+    adcFilterNone: 'No filter',
+    adcFilterMedian: 'Median',
+    adcFilterEwma: 'EWMA',
+    pushOnChange: 'Push changes only',
+    pushOnChangeInfo: 'If activated, the measured values are only pushed automatically if they changed by more than the deadbands.\nThis reduces the radio transmissions and the power consumption.',
+    deadbands: 'Deadbands (ADC, °C/%, battery %)',
+    deadbandsInfo: 'Changes up to these values are not pushed.\nADC values in ADC steps, temperature and humidity in steps of 0.1, battery in percent.',
+    heartbeatInterval: 'Heartbeat interval',
+    heartbeatIntervalInfo: 'If only changes are pushed, all measured values are pushed at least after this time, so a failure of the system can be detected.\n<code>0</code> disables the heartbeat.',
+    valveQueue: 'Queue (order, max valves, gap s)',
+    valveQueueInfo: 'Channels to be watered are waiting in a queue.\nOrder: In the order of the requests or the driest channel first.\nMax valves: Number of valves which may be open at the same time.\nGap: Time in seconds after a valve is closed before the next one is opened.',
+    valveOrderFifo: 'Request',
+    valveOrderDriest: 'Driest first',
+    checkAdaptive: 'Adaptive check interval (min s, max s)',
+    checkAdaptiveInfo: 'If activated, an interval between the minimum and maximum is used instead of the fixed check interval.\nNear the trigger value, on fast rising values and right after a watering the checks are more often, on stable values far away from the trigger value less often.',
+    sensorsWarmup: 'Sensors warmup time (ms, tolerance)',
+    sensorsWarmupInfo: 'Max time in milliseconds the sensors are turned on before reading the values.\nThe values are read earlier as soon as two readings of each sensor differ by not more than the tolerance.\n<code>0</code> as tolerance always waits the whole warmup time.',
+    routeVia: 'To the server via',
+    routeViaInfo: 'Only with <code>RH_ROUTING 1</code>.\nAddress of the neighbour relaying the messages to the server.\n<code>255</code> sends directly to the server.',
+    '0xFFor255': '0xFF or 255',
     sendAdcValues: 'Send ADC values',
     sendAdcValuesInfo: 'If activated, the measured ADC values are transmitted via RadioHead.\nIf deactivated, only the switching states of the individual channels are transmitted.',
     enableAutomaticDataPush: 'Automatic data push',
@@ -216,6 +273,7 @@ const translations = {
     temperature: 'Temperature',
     humidity: 'Humidity',
     battery: 'Battery',
+    memory: 'Memory',
     system: 'System',
     pause: 'Pause',
     resume: 'Resume',
@@ -20,15 +20,33 @@ const path = require('path');
 const RH_MSG_START =         0x00;
 const RH_MSG_BATTERY =       0x02;
 const RH_MSG_SENSOR_VALUES = 0x10;
+const RH_MSG_TELEMETRY =     0x11; // >= v2.4.0 only
+const RH_MSG_BATCH =         0x12; // >= v2.4.0 only
 const RH_MSG_TEMP_SENSOR_DATA = 0x20;
 const RH_MSG_CHANNEL_ON =    0x21; // < v2.0.0 only
 const RH_MSG_CHANNEL_OFF =   0x22; // < v2.0.0 only
 const RH_MSG_CHANNEL_STATE = 0x25; // >= v2.0.0 only
+const RH_MSG_TX_STATS =      0x30; // >= v2.4.0 only
+const RH_MSG_POWER_STATS =   0x31; // >= v2.4.0 only
+const RH_MSG_LOOP_STATS =    0x32; // >= v2.4.0 only
+const RH_MSG_MEMORY_STATS =  0x33; // >= v2.4.0 only
+const RH_MSG_HISTORY =       0x34; // >= v2.4.0 only
+const RH_MSG_VALVE_QUEUE =   0x35; // >= v2.4.0 only
+const RH_MSG_SENSOR_STATS =  0x36; // >= v2.4.0 only
+const RH_MSG_ROUTE_STATS =   0x37; // >= v2.4.0 only
+const RH_MSG_TASK_STATS =    0x38; // >= v2.4.0 only
 
 const RH_MSG_SETTINGS =      0x50;
 const RH_MSG_GET_SETTINGS =  0x51;
 const RH_MSG_SET_SETTINGS =  0x52;
 const RH_MSG_SAVE_SETTINGS = 0x53;
+const RH_MSG_EXT_SETTINGS =      0x54; // >= v2.4.0 only
+const RH_MSG_GET_EXT_SETTINGS =  0x55; // >= v2.4.0 only
+const RH_MSG_SET_EXT_SETTINGS =  0x56; // >= v2.4.0 only
+const RH_MSG_PATCH_SETTINGS =    0x57; // >= v2.4.0 only
+const RH_MSG_SETTINGS_PATCHED =  0x58; // >= v2.4.0 only
+const RH_MSG_CHANNEL_SETTINGS =  0x59; // >= v2.4.0 only
+const RH_MSG_GET_CHANNEL_SETTINGS = 0x5A; // >= v2.4.0 only
 
 const RH_MSG_CHECK_NOW =        0x60;
 const RH_MSG_TURN_CHANNEL_ON =  0x61; // < v2.0.0 only
@@ -39,17 +57,115 @@ const RH_MSG_TURN_CHANNEL_ON_OFF = 0x65; // >= v2.0.0 only
 const RH_MSG_POLL_DATA =        0x66; // >= v2.0.0 only
 const RH_MSG_PAUSE_ON_OFF =     0x67; // >= v2.0.0 only
 const RH_MSG_TURN_TEMP_SWITCH_ON_OFF = 0x68; // >= v2.2.0 only
+const RH_MSG_GET_TX_STATS =     0x69; // >= v2.4.0 only
+const RH_MSG_GET_POWER_STATS =  0x6A; // >= v2.4.0 only
+const RH_MSG_GET_LOOP_STATS =   0x6B; // >= v2.4.0 only
+const RH_MSG_GET_MEMORY_STATS = 0x6C; // >= v2.4.0 only
+const RH_MSG_GET_HISTORY =      0x6D; // >= v2.4.0 only
+const RH_MSG_GET_VALVE_QUEUE =  0x6E; // >= v2.4.0 only
+const RH_MSG_GET_SENSOR_STATS = 0x6F; // >= v2.4.0 only
+const RH_MSG_GET_ROUTE_STATS =  0x70; // >= v2.4.0 only
+const RH_MSG_GET_TASK_STATS =   0x71; // >= v2.4.0 only
 
 const RH_MSG_GET_VERSION =      0xF0;
 const RH_MSG_VERSION =          0xF1;
 const RH_MSG_PING =             0xF2;
 const RH_MSG_PONG =             0xF3;
 
+// presence flags of the telemetry message
+const RH_TELEMETRY_SENSORS =     0x01;
+const RH_TELEMETRY_BATTERY =     0x02;
+const RH_TELEMETRY_TEMP =        0x04;
+const RH_TELEMETRY_HUMIDITY =    0x08;
+const RH_TELEMETRY_TEMP_SWITCH = 0x10;
+const RH_TELEMETRY_PAUSED =      0x20;
+const RH_TELEMETRY_FIXED =       0x40;
+
+// fields of the settings patch message
+// max length of a message and rejected field of the ack if all fields are applied
+const SETTINGS_PATCH_MAX_LEN = 28;
+const SETTINGS_PATCH_OK = 0xFF;
+const SETTINGS_FIELDS = [
+  { id: 0x00, size: 1, get: (s) => s.channelEnabled.reduce((mask, enabled, chan) => enabled ? mask | (1 << chan) : mask, 0) },
+  { id: 0x01, size: 2, get: (s) => s.checkInterval },
+  { id: 0x02, size: 2, get: (s) => s.tempSensorInterval },
+  { id: 0x03, size: 1, get: (s) => s.sendAdcValuesThroughRH ? 1 : 0 },
+  { id: 0x04, size: 1, get: (s) => s.pushDataEnabled ? 1 : 0 },
+  { id: 0x05, size: 1, get: (s) => s.serverAddress },
+  { id: 0x06, size: 1, get: (s) => s.nodeAddress },
+  { id: 0x07, size: 2, get: (s) => s.delayAfterSend },
+  { id: 0x08, size: 1, signed: true, get: (s) => s.tempSwitchTriggerValue },
+  { id: 0x09, size: 1, get: (s) => Math.floor(s.tempSwitchHyst * 10) },
+  { id: 0x0A, size: 1, get: (s) => s.tempSwitchInverted ? 1 : 0 },
+  { id: 0x0B, size: 1, get: (s) => s.adcOversampling },
+  { id: 0x0C, size: 1, get: (s) => s.adcFilterType },
+  { id: 0x0D, size: 1, get: (s) => s.adcFilterDepth },
+  { id: 0x0E, size: 1, get: (s) => s.pushOnChange ? 1 : 0 },
+  { id: 0x0F, size: 1, get: (s) => s.deadbandAdc },
+  { id: 0x10, size: 1, get: (s) => Math.round(s.deadbandTemp * 10) },
+  { id: 0x11, size: 1, get: (s) => s.deadbandBattery },
+  { id: 0x12, size: 2, get: (s) => s.heartbeatInterval },
+  { id: 0x13, size: 1, get: (s) => s.valveMax },
+  { id: 0x14, size: 2, get: (s) => s.valveGap },
+  { id: 0x15, size: 1, get: (s) => s.valveOrder },
+  { id: 0x16, size: 1, get: (s) => s.checkAdaptive ? 1 : 0 },
+  { id: 0x17, size: 2, get: (s) => s.checkIntervalMin },
+  { id: 0x18, size: 2, get: (s) => s.checkIntervalMax },
+  { id: 0x19, size: 2, get: (s) => s.sensorsWarmup },
+  { id: 0x1A, size: 1, get: (s) => s.settleTolerance },
+  { id: 0x1B, size: 1, get: (s) => s.routeVia }
+];
+// per channel fields, the id is increased by the channel number
+const SETTINGS_CHANNEL_FIELDS = [
+  { id: 0x20, size: 2, get: (s, chan) => s.adcTriggerValue[chan] },
+  { id: 0x28, size: 2, get: (s, chan) => s.wateringTime[chan] }
+];
+
+// history messages
+const HISTORY_CHUNK_MORE = 0x80;
+const HISTORY_NO_AGE =     0xFFFF;
+const HISTORY_NO_TEMP =    -0x8000;
+const HISTORY_NO_VALUE =   0xFF;
+// max number of history samples kept in the control app
+const HISTORY_MAX_SAMPLES = 1000;
+
+// names of the sites in a loop pass of the watering system
+const LOOP_SITES = {
+  0x00: 'temp sensor',
+  0x01: 'sensors on',
+  0x02: 'adc read',
+  0x03: 'radio poll',
+  0x04: 'led',
+  0x05: 'temp sensor read',
+  0x06: 'radio send',
+  0x07: 'heartbeat',
+  0x08: 'valve queue',
+  0x09: 'sensors settle',
+  0x0A: 'valve off 0',
+  0x0B: 'valve off 1',
+  0x0C: 'valve off 2',
+  0x0D: 'valve off 3',
+  0x0E: 'valve off 4',
+  0x0F: 'valve off 5',
+  0x10: 'valve off 6',
+  0x11: 'valve off 7',
+  0xF0: 'channels',
+  0xF1: 'adc values',
+  0xFF: 'none'
+};
+
+// lower bounds of the loop pass time histogram buckets in microseconds
+const LOOP_HISTOGRAM_BUCKETS = [0, 256, 1024, 4096, 16384, 65536, 262144, 1048576];
+
 class Watering {
 
   constructor () {
     // defaults
     this.addressClient = 0xDC;
+    this.addressThis = 0x01;
+    this.routed = false;
+    this.routeVia = 0xDC;
+    this.routeId = 0;
     this.connected = false;
     this.settings = null;
     this.status = {
@@ -60,11 +176,24 @@ class Watering {
       batVolt: '-',
       temperature: '-',
       humidity: '-',
-      on: [false, false, false, false]
+      on: [false, false, false, false],
+      paused: false,
+      txStats: null,
+      powerStats: null,
+      loopStats: null,
+      memoryStats: null,
+      valveQueue: null,
+      sensorStats: null,
+      routeStats: null,
+      taskStats: null
     };
     this.softwareVersion = '';
+    this.channelCount = 4;
     this.softwareVersionControl = require('./package.json').version;
     this.logData = [];
+    this.history = [];
+    this.historySeq = 0;
+    this.historyTimeout = null;
     this.lastPingData = Buffer.alloc(4);
     this.versionInterval = null;
 
@@ -72,6 +201,8 @@ class Watering {
     this.apiCheckNow = this.apiCheckNow.bind(this);
     this.apiPoll = this.apiPoll.bind(this);
     this.apiPing = this.apiPing.bind(this);
+    this.apiGetDiagnostics = this.apiGetDiagnostics.bind(this);
+    this.apiGetHistory = this.apiGetHistory.bind(this);
     this.apiConnect = this.apiConnect.bind(this);
     this.apiDisconnect = this.apiDisconnect.bind(this);
     this.apiGetInfo = this.apiGetInfo.bind(this);
@@ -102,6 +233,8 @@ class Watering {
     this.app.get('/api/checkNow', this.apiCheckNow);
     this.app.get('/api/poll', this.apiPoll);
     this.app.get('/api/ping', this.apiPing);
+    this.app.get('/api/getDiagnostics', this.apiGetDiagnostics);
+    this.app.get('/api/getHistory', this.apiGetHistory);
     this.app.get('/api/getInfo', this.apiGetInfo);
     this.app.get('/api/getPorts', this.apiGetPorts);
     this.app.get('/api/getSettings', this.apiGetSettings);
@@ -130,7 +263,9 @@ class Watering {
       log: this.logData,
       settings: this.settings,
       status: this.status,
+      history: this.history,
       softwareVersion: this.softwareVersion,
+      channelCount: this.channelCount,
       softwareVersionControl: this.softwareVersionControl
     });
   }
@@ -171,7 +306,21 @@ class Watering {
       this.addressClient = parseInt(req.body.addressClient, 10);
     }
 
-    if (port.length > 0 && baud > 0 && addressThis > 0 && addressThis < 255 && this.addressClient > 0 && this.addressClient < 255) {
+    // routed mode for systems built with RH_ROUTING, optionally via another node
+    const routeVia = req.body.routeVia || '';
+    this.addressThis = addressThis;
+    this.routed = routeVia.length > 0;
+    if (routeVia.startsWith('0x')) {
+      this.routeVia = parseInt(routeVia, 16);
+    } else {
+      this.routeVia = parseInt(routeVia, 10);
+    }
+    if (!this.routed) {
+      this.routeVia = this.addressClient;
+    }
+
+    if (port.length > 0 && baud > 0 && addressThis > 0 && addressThis < 255 && this.addressClient > 0 && this.addressClient < 255 &&
+      this.routeVia > 0 && this.routeVia < 255) {
       res.status(200);
       res.send('Ok');
     } else {
@@ -191,7 +340,8 @@ class Watering {
 
     this.connected = true;
 
-    this.log(`connected to the serial-radio gateway via ${req.body.port}, baud ${req.body.baud}`);
+    this.log(`connected to the serial-radio gateway via ${req.body.port}, baud ${req.body.baud}` +
+      (this.routed ? `, routed via 0x${this.routeVia.toString(16)}` : ''));
 
     // request the software version from the watering system
     // use an interval to retry until we got a version
@@ -257,6 +407,53 @@ class Watering {
     res.send('Ok');
   }
 
+  /**
+   * API endpoint for requesting the diagnostic data from the watering system.
+   * Supported since v2.4.0
+   */
+  apiGetDiagnostics (req, res, next) {
+    if (!semver.satisfies(this.softwareVersion, '>=2.4.0')) {
+      res.status(400);
+      res.send('Not supported by the watering system');
+      return;
+    }
+
+    for (const msgType of [RH_MSG_GET_TX_STATS, RH_MSG_GET_POWER_STATS, RH_MSG_GET_LOOP_STATS, RH_MSG_GET_MEMORY_STATS, RH_MSG_GET_VALVE_QUEUE, RH_MSG_GET_SENSOR_STATS, RH_MSG_GET_ROUTE_STATS, RH_MSG_GET_TASK_STATS]) {
+      const buf = Buffer.alloc(1);
+      buf[0] = msgType;
+      this.rhsSend(buf);
+    }
+
+    res.send('Ok');
+  }
+
+  /**
+   * API endpoint for requesting the history samples from the watering system,
+   * starting after the last received sample.
+   * Supported since v2.4.0
+   */
+  apiGetHistory (req, res, next) {
+    if (!semver.satisfies(this.softwareVersion, '>=2.4.0')) {
+      res.status(400);
+      res.send('Not supported by the watering system');
+      return;
+    }
+
+    this.requestHistory();
+
+    res.send('Ok');
+  }
+
+  /**
+   * Method to request the next history samples from the watering system.
+   */
+  requestHistory () {
+    const buf = Buffer.alloc(3);
+    buf[0] = RH_MSG_GET_HISTORY;
+    buf.writeUInt16LE(this.historySeq, 1);
+    this.rhsSend(buf);
+  }
+
   /**
    * API endpoint for sending a 'get settings' command to the watering system.
    */
@@ -265,6 +462,17 @@ class Watering {
     buf[0] = RH_MSG_GET_SETTINGS;
     this.rhsSend(buf);
 
+    if (semver.satisfies(this.softwareVersion, '>=2.4.0')) {
+      buf = Buffer.alloc(1);
+      buf[0] = RH_MSG_GET_EXT_SETTINGS;
+      this.rhsSend(buf);
+
+      // the settings message contains only the first four channels
+      for (let chan = 4; chan < this.channelCount; chan++) {
+        this.rhsSend(Buffer.from([RH_MSG_GET_CHANNEL_SETTINGS, chan]));
+      }
+    }
+
     res.send('Ok');
   }
 
@@ -272,12 +480,20 @@ class Watering {
    * API endpoint for sending new settings to the watering system.
    */
   apiSetSettings (req, res, next) {
+    const oldSettings = this.settings;
     this.settings = {
       channelEnabled: [],
       adcTriggerValue: [],
       wateringTime: []
     };
-    for (let chan = 0; chan < 4; chan++) {
+    for (let chan = 0; chan < this.channelCount; chan++) {
+      if (chan >= req.body.channelEnabled.length) {
+        // keep the channels not shown by the client
+        this.settings.channelEnabled[chan] = oldSettings ? oldSettings.channelEnabled[chan] : false;
+        this.settings.adcTriggerValue[chan] = oldSettings ? oldSettings.adcTriggerValue[chan] : NaN;
+        this.settings.wateringTime[chan] = oldSettings ? oldSettings.wateringTime[chan] : NaN;
+        continue;
+      }
       this.settings.channelEnabled[chan] = req.body.channelEnabled[chan];
       this.settings.adcTriggerValue[chan] = parseInt(req.body.adcTriggerValue[chan], 10);
       this.settings.wateringTime[chan] = parseInt(req.body.wateringTime[chan], 10);
@@ -310,6 +526,36 @@ class Watering {
       this.settings.tempSwitchInverted = req.body.tempSwitchInverted;
     }
 
+    if (semver.satisfies(this.softwareVersion, '>=2.4.0')) {
+      this.settings.adcOversampling = parseInt(req.body.adcOversampling, 10);
+      this.settings.adcFilterType = parseInt(req.body.adcFilterType, 10);
+      this.settings.adcFilterDepth = parseInt(req.body.adcFilterDepth, 10);
+      this.settings.pushOnChange = !!req.body.pushOnChange;
+      this.settings.deadbandAdc = parseInt(req.body.deadbandAdc, 10);
+      this.settings.deadbandTemp = parseFloat(req.body.deadbandTemp);
+      this.settings.deadbandBattery = parseInt(req.body.deadbandBattery, 10);
+      this.settings.heartbeatInterval = parseInt(req.body.heartbeatInterval, 10);
+      this.settings.valveMax = parseInt(req.body.valveMax, 10);
+      this.settings.valveGap = parseInt(req.body.valveGap, 10);
+      this.settings.valveOrder = parseInt(req.body.valveOrder, 10);
+      this.settings.checkAdaptive = !!req.body.checkAdaptive;
+      this.settings.checkIntervalMin = parseInt(req.body.checkIntervalMin, 10);
+      this.settings.checkIntervalMax = parseInt(req.body.checkIntervalMax, 10);
+      this.settings.sensorsWarmup = parseInt(req.body.sensorsWarmup, 10);
+      this.settings.settleTolerance = parseInt(req.body.settleTolerance, 10);
+      // keep the current next hop if none or no valid one is given
+      const routeVia = req.body.routeVia || '';
+      const routeViaValue = routeVia.startsWith('0x') ? parseInt(routeVia, 16) : parseInt(routeVia, 10);
+      if (!isNaN(routeViaValue)) {
+        this.settings.routeVia = routeViaValue;
+      }
+
+      // only the changed fields are send, so no settings are needed from the system first
+      this.sendSettingsPatch(oldSettings);
+      res.send('Ok');
+      return;
+    }
+
     let buf;
     if (semver.satisfies(this.softwareVersion, '>=2.2.0')) {
       buf = Buffer.alloc(28);
@@ -361,6 +607,47 @@ class Watering {
     res.send('Ok');
   }
 
+  /**
+   * Method to send the settings which differ from the given old settings as
+   * (field id, value) pairs. Without old settings all fields are send.
+   * @param oldSettings The settings known before or null.
+   */
+  sendSettingsPatch (oldSettings) {
+    const pairs = [];
+    const addPair = (field, chan) => {
+      const value = field.get(this.settings, chan);
+      if (isNaN(value) || (oldSettings && field.get(oldSettings, chan) === value)) {
+        return;
+      }
+
+      const pair = Buffer.alloc(1 + field.size);
+      pair[0] = field.id + chan;
+      if (field.signed) {
+        pair.writeIntLE(value, 1, field.size);
+      } else {
+        pair.writeUIntLE(value, 1, field.size);
+      }
+      pairs.push(pair);
+    };
+    SETTINGS_FIELDS.forEach((field) => addPair(field, 0));
+    for (let chan = 0; chan < this.channelCount; chan++) {
+      SETTINGS_CHANNEL_FIELDS.forEach((field) => addPair(field, chan));
+    }
+
+    let buf = Buffer.from([RH_MSG_PATCH_SETTINGS]);
+    for (const pair of pairs) {
+      if (buf.length + pair.length > SETTINGS_PATCH_MAX_LEN) {
+        this.rhsSend(buf);
+        buf = Buffer.from([RH_MSG_PATCH_SETTINGS]);
+      }
+      buf = Buffer.concat([buf, pair]);
+    }
+
+    if (buf.length > 1) {
+      this.rhsSend(buf);
+    }
+  }
+
   /**
    * API endpoint for sending a 'save settings' command to the watering system.
    */
@@ -381,9 +668,9 @@ class Watering {
     let buf;
     if (semver.satisfies(this.softwareVersion, '>=2.0.0')) {
       // >= v2.0.0
-      buf = Buffer.alloc(5);
+      buf = Buffer.alloc(1 + this.channelCount);
       buf[0] = RH_MSG_TURN_CHANNEL_ON_OFF;
-      for (let chan = 0; chan < 4; chan++) {
+      for (let chan = 0; chan < this.channelCount; chan++) {
         if (chan === chanToSet) {
           buf[chan + 1] = req.body.on ? 0x01 : 0x00;
         } else {
@@ -486,7 +773,13 @@ class Watering {
    * @param buf A Buffer containing the data to send.
    */
   rhsSend (buf) {
-    this.rhs.send(this.addressClient, buf)
+    let frame = buf;
+    if (this.routed) {
+      // route header with destination, source, hops, id and flags
+      frame = Buffer.concat([Buffer.from([this.addressClient, this.addressThis, 0, this.routeId, 0]), buf]);
+      this.routeId = (this.routeId + 1) & 0xFF;
+    }
+    this.rhs.send(this.routeVia, frame)
     .then(() => {
       this.log('send message ' + this.bufferToHexString(buf));
     })
@@ -500,6 +793,14 @@ class Watering {
    * @param msg The received message as Buffer.
    */
   rhsReceived (msg) {
+    if (this.routed && msg.hops === undefined) {
+      // the source is in the route header, the sender may be a relaying node
+      if (msg.data.length < 6 || msg.data[1] !== this.addressClient) {
+        return;
+      }
+      msg = Object.assign({}, msg, { headerFrom: msg.data[1], hops: msg.data[2], data: msg.data.slice(5) });
+    }
+
     // filter messages
     if (msg.headerFrom !== this.addressClient) {
       return;
@@ -512,6 +813,13 @@ class Watering {
         this.log('system started');
         break;
 
+      case RH_MSG_BATCH: // >= v2.4.0
+        // multiple replies in one frame, each with a length byte in front
+        for (let pos = 1; pos < msg.data.length && msg.data[pos] > 0; pos += 1 + msg.data[pos]) {
+          this.rhsReceived(Object.assign({}, msg, { data: msg.data.slice(pos + 1, pos + 1 + msg.data[pos]) }));
+        }
+        break;
+
       case RH_MSG_BATTERY:
         this.status.batPercent = msg.data[1];
         this.status.batRaw = msg.data.readUInt16LE(2);
@@ -521,19 +829,104 @@ class Watering {
         break;
 
       case RH_MSG_SENSOR_VALUES:
-        for (let i = 0; i < 4; i++) {
+        for (let i = 0; i < this.channelCount; i++) {
           this.status.adcRaw[i] = msg.data.readUInt16LE(1 + i*2);
           this.status.adcVolt[i] = 5/1023*this.status.adcRaw[i];
           this.status.adcVolt[i] = Math.round(this.status.adcVolt[i]*100)/100;
         }
-        this.log('sensors: ' +
-          this.status.adcVolt[0] + 'V (' + this.status.adcRaw[0] + ') ' +
-          this.status.adcVolt[1] + 'V (' + this.status.adcRaw[1] + ') ' +
-          this.status.adcVolt[2] + 'V (' + this.status.adcRaw[2] + ') ' +
-          this.status.adcVolt[3] + 'V (' + this.status.adcRaw[3] + ')');
+        this.log('sensors: ' + this.status.adcVolt.map((volt, i) => `${volt}V (${this.status.adcRaw[i]})`).join(' '));
+        break;
+
+      case RH_MSG_TELEMETRY: // >= v2.4.0
+        {
+          const flags = msg.data[1];
+          let pos = 4;
+
+          for (let chan = 0; chan < this.channelCount; chan++) {
+            const newChanState = ((msg.data[2] & (1 << chan)) != 0);
+            if (newChanState !== this.status.on[chan]) {
+              this.status.on[chan] = newChanState;
+              this.log(`channel ${chan} ${newChanState ? 'on' : 'off'}`);
+            }
+          }
+
+          if (flags & RH_TELEMETRY_SENSORS) {
+            for (let i = 0; i < this.channelCount; i++) {
+              this.status.adcRaw[i] = msg.data.readUInt16LE(pos);
+              this.status.adcVolt[i] = 5/1023*this.status.adcRaw[i];
+              this.status.adcVolt[i] = Math.round(this.status.adcVolt[i]*100)/100;
+              pos += 2;
+            }
+          }
+
+          if (flags & RH_TELEMETRY_BATTERY) {
+            this.status.batPercent = msg.data[pos];
+            this.status.batRaw = msg.data.readUInt16LE(pos + 1);
+            this.status.batVolt = 5/1023*this.status.batRaw;
+            this.status.batVolt = Math.round(this.status.batVolt*100)/100;
+            pos += 3;
+          }
+
+          // temperature and humidity as int16 in hundredth or as float
+          if (flags & RH_TELEMETRY_TEMP) {
+            if (flags & RH_TELEMETRY_FIXED) {
+              this.status.temperature = msg.data.readInt16LE(pos) / 100;
+              pos += 2;
+            } else {
+              this.status.temperature = msg.data.readFloatLE(pos);
+              pos += 4;
+            }
+            this.status.temperature = Math.round(this.status.temperature*10)/10;
+          } else {
+            this.status.temperature = '-';
+          }
+
+          if (flags & RH_TELEMETRY_HUMIDITY) {
+            if (flags & RH_TELEMETRY_FIXED) {
+              this.status.humidity = msg.data.readInt16LE(pos) / 100;
+              pos += 2;
+            } else {
+              this.status.humidity = msg.data.readFloatLE(pos);
+              pos += 4;
+            }
+            this.status.humidity = Math.round(this.status.humidity*10)/10;
+          } else {
+            this.status.humidity = '-';
+          }
+
+          this.status.tempSwitchOn = ((flags & RH_TELEMETRY_TEMP_SWITCH) != 0);
+          this.status.paused = ((flags & RH_TELEMETRY_PAUSED) != 0);
+
+          this.log('telemetry: ' +
+            ((flags & RH_TELEMETRY_SENSORS) ? `sensors ${this.status.adcVolt.join('V ')}V, ` : '') +
+            ((flags & RH_TELEMETRY_BATTERY) ? `battery ${this.status.batPercent} % ${this.status.batVolt} V, ` : '') +
+            ((flags & RH_TELEMETRY_TEMP) ? `temperature ${this.status.temperature} °C, ` : '') +
+            ((flags & RH_TELEMETRY_HUMIDITY) ? `humidity ${this.status.humidity} %, ` : '') +
+            (this.status.paused ? 'paused' : 'running'));
+        }
         break;
 
       case RH_MSG_TEMP_SENSOR_DATA:
+        if (msg.data.length === 7 && (msg.data[1] & RH_TELEMETRY_FIXED)) {
+          // >= v2.4.0: byte 1 are the telemetry flags, int16 values in hundredth, byte 6 is tempSwitchOn
+          // the floats of older versions are 5, 6, 9 or 10 bytes long
+          const flags = msg.data[1];
+          if (flags & RH_TELEMETRY_TEMP) {
+            this.status.temperature = Math.round(msg.data.readInt16LE(2) / 10) / 10;
+            this.log(`temperature: ${this.status.temperature} °C `);
+          } else {
+            this.status.temperature = '-';
+          }
+          if (flags & RH_TELEMETRY_HUMIDITY) {
+            this.status.humidity = Math.round(msg.data.readInt16LE(4) / 10) / 10;
+            this.log(`humidity: ${this.status.humidity} %`);
+          } else {
+            this.status.humidity = '-';
+          }
+          this.status.tempSwitchOn = (msg.data[6] >= 0x01);
+          break;
+        }
+
         if (msg.data.length >= 5) {
           this.status.temperature = msg.data.readFloatLE(1);
           this.status.temperature = Math.round(this.status.temperature*10)/10;
@@ -571,7 +964,7 @@ class Watering {
         break;
 
       case RH_MSG_CHANNEL_STATE: // >= v2.0.0
-        for (let chan = 0; chan < 4; chan++) {
+        for (let chan = 0; chan < this.channelCount; chan++) {
           const newChanState = !!msg.data[chan+1];
           if (newChanState !== this.status.on[chan]) {
             this.status.on[chan] = newChanState;
@@ -588,7 +981,7 @@ class Watering {
           adcTriggerValue: [],
           wateringTime: []
         };
-        for (let chan = 0; chan < 4; chan++) {
+        for (let chan = 0; chan < Math.min(this.channelCount, 4); chan++) {
           this.settings.channelEnabled[chan] = ((msg.data[1] & (1 << chan)) != 0);
           this.settings.adcTriggerValue[chan] = msg.data.readUInt16LE(2+chan*2);
           this.settings.wateringTime[chan] = msg.data.readUInt16LE(10+chan*2);
@@ -612,11 +1005,278 @@ class Watering {
         }
         break;
 
+      case RH_MSG_CHANNEL_SETTINGS: // >= v2.4.0
+        if (!this.settings) {
+          // wait for the main settings
+          break;
+        }
+        this.log(`got settings of channel ${msg.data[1]}`);
+        this.settings.time = (new Date()).getTime();
+        this.settings.channelEnabled[msg.data[1]] = (msg.data[2] === 0x01);
+        this.settings.adcTriggerValue[msg.data[1]] = msg.data.readUInt16LE(3);
+        this.settings.wateringTime[msg.data[1]] = msg.data.readUInt16LE(5);
+        break;
+
+      case RH_MSG_TX_STATS: // >= v2.4.0
+        this.status.txStats = {
+          queue: msg.data[1],
+          queueMax: msg.data[2],
+          sent: msg.data.readUInt16LE(3),
+          retries: msg.data.readUInt16LE(5),
+          failed: msg.data.readUInt16LE(7),
+          dropped: msg.data.readUInt16LE(9)
+        };
+        if (msg.data.length >= 25) {
+          // airtime in ms, duty cycle within the window in hundredth of a percent
+          this.status.txStats.airtime = msg.data.readUInt32LE(11);
+          this.status.txStats.airtimeWindow = msg.data.readUInt32LE(15);
+          this.status.txStats.dutyCycle = msg.data.readUInt16LE(19) / 100;
+          this.status.txStats.deferred = msg.data.readUInt16LE(21);
+          this.status.txStats.merged = msg.data.readUInt16LE(23);
+        }
+        if (msg.data.length >= 27) {
+          // transmissions put back because the channel was in use
+          this.status.txStats.busy = msg.data.readUInt16LE(25);
+        }
+        this.log(`tx stats: queue ${this.status.txStats.queue}/${this.status.txStats.queueMax}, ` +
+          `sent ${this.status.txStats.sent}, retries ${this.status.txStats.retries}, ` +
+          `failed ${this.status.txStats.failed}, dropped ${this.status.txStats.dropped}`);
+        if (msg.data.length >= 25) {
+          this.log(`tx airtime: total ${this.status.txStats.airtime}ms, window ${this.status.txStats.airtimeWindow}ms ` +
+            `(${this.status.txStats.dutyCycle}%), deferred ${this.status.txStats.deferred}, merged ${this.status.txStats.merged}`);
+        }
+        if (msg.data.length >= 27) {
+          this.log(`tx channel busy: ${this.status.txStats.busy}`);
+        }
+        break;
+
+      case RH_MSG_POWER_STATS: // >= v2.4.0
+        this.status.powerStats = {
+          mode: msg.data[1],
+          dutyCycle: msg.data.readUInt16LE(2) / 10,
+          uptime: msg.data.readUInt32LE(4),
+          sleepTime: msg.data.readUInt32LE(8),
+          checkInterval: msg.data.length >= 18 ? msg.data.readUInt16LE(12) : null,
+          sensorsOnTime: msg.data.length >= 18 ? msg.data.readUInt32LE(14) / 1000 : null
+        };
+        this.log(`power stats: mode ${this.status.powerStats.mode}, awake ${this.status.powerStats.dutyCycle} %, ` +
+          `uptime ${this.status.powerStats.uptime} s, sleeping ${this.status.powerStats.sleepTime} s, ` +
+          `check interval ${this.status.powerStats.checkInterval} s, sensors on ${this.status.powerStats.sensorsOnTime} s`);
+        break;
+
+      case RH_MSG_LOOP_STATS: // >= v2.4.0
+        this.status.loopStats = {
+          passes: msg.data.readUInt32LE(1),
+          passMax: msg.data.readUInt32LE(5),
+          passAvg: msg.data.readUInt16LE(9),
+          stallSite: LOOP_SITES[msg.data[11]] || `unknown (${msg.data[11]})`,
+          histogram: LOOP_HISTOGRAM_BUCKETS.map((from, i) => ({ from, count: msg.data.readUInt16LE(12 + i * 2) }))
+        };
+        this.log(`loop stats: ${this.status.loopStats.passes} passes, avg ${this.status.loopStats.passAvg} us, ` +
+          `max ${this.status.loopStats.passMax} us caused by ${this.status.loopStats.stallSite}, ` +
+          `histogram ${this.status.loopStats.histogram.map((b) => `>=${b.from}us:${b.count}`).join(' ')}`);
+        break;
+
+      case RH_MSG_TASK_STATS: // >= v2.4.0
+        {
+          // the tasks are split into multiple messages starting at the task id in [1]
+          if (msg.data[1] === 0 || !this.status.taskStats) {
+            this.status.taskStats = [];
+          }
+          const tasks = [];
+          for (let i = 0; i < msg.data[2] && 6 + i * 4 < msg.data.length; i++) {
+            const task = {
+              task: LOOP_SITES[msg.data[1] + i] || `task ${msg.data[1] + i}`,
+              maxLateness: msg.data.readUInt16LE(3 + i * 4),
+              maxRunTime: msg.data.readUInt16LE(5 + i * 4)
+            };
+            this.status.taskStats[msg.data[1] + i] = task;
+            tasks.push(task);
+          }
+          this.log('task stats: ' + tasks.map((t) => `${t.task} late ${t.maxLateness} ms, run ${t.maxRunTime} ms`).join(', '));
+        }
+        break;
+
+      case RH_MSG_MEMORY_STATS: // >= v2.4.0
+        this.status.memoryStats = {
+          ramSize: msg.data.readUInt16LE(1),
+          staticRam: msg.data.readUInt16LE(3),
+          heapUsed: msg.data.readUInt16LE(5),
+          stackUsed: msg.data.readUInt16LE(7),
+          stackMax: msg.data.readUInt16LE(9),
+          free: msg.data.readUInt16LE(11),
+          minFree: msg.data.readUInt16LE(13),
+          flashUsed: msg.data.readUInt16LE(15)
+        };
+        this.log(`memory: ${this.status.memoryStats.free} B free (min ${this.status.memoryStats.minFree} B) of ${this.status.memoryStats.ramSize} B, ` +
+          `static ${this.status.memoryStats.staticRam} B, heap ${this.status.memoryStats.heapUsed} B, ` +
+          `stack ${this.status.memoryStats.stackUsed} B (max ${this.status.memoryStats.stackMax} B), flash ${this.status.memoryStats.flashUsed} B`);
+        break;
+
+      case RH_MSG_VALVE_QUEUE: // >= v2.4.0
+        this.status.valveQueue = {
+          on: [],
+          remaining: msg.data.readUInt16LE(2),
+          waiting: [...msg.data.slice(5, 5 + msg.data[4])]
+        };
+        for (let chan = 0; chan < this.channelCount; chan++) {
+          if (msg.data[1] & (1 << chan)) {
+            this.status.valveQueue.on.push(chan);
+          }
+        }
+        this.log(`valve queue: open [${this.status.valveQueue.on.join(', ')}], ` +
+          `waiting [${this.status.valveQueue.waiting.join(', ')}], done in ${this.status.valveQueue.remaining} s`);
+        break;
+
+      case RH_MSG_SENSOR_STATS: // >= v2.4.0
+        this.status.sensorStats = {
+          settled: [],
+          settleTime: []
+        };
+        for (let chan = 0; chan < this.channelCount && 3 + chan * 2 < msg.data.length; chan++) {
+          this.status.sensorStats.settled.push(!!(msg.data[1] & (1 << chan)));
+          this.status.sensorStats.settleTime.push(msg.data.readUInt16LE(2 + chan * 2));
+        }
+        this.log(`sensor stats: settle times [${this.status.sensorStats.settleTime.join(', ')}] ms, ` +
+          `settled [${this.status.sensorStats.settled.join(', ')}]`);
+        break;
+
+      case RH_MSG_ROUTE_STATS: // >= v2.4.0
+        this.status.routeStats = {
+          routed: (msg.data[1] === 0x01),
+          serverHops: (msg.data[2] === 0xFF) ? null : msg.data[2],
+          forwarded: msg.data.readUInt16LE(3),
+          dropped: msg.data.readUInt16LE(5),
+          routes: []
+        };
+        for (let i = 0; i < msg.data[7] && 10 + i * 3 < msg.data.length; i++) {
+          this.status.routeStats.routes.push({
+            dest: msg.data[8 + i * 3],
+            nextHop: msg.data[9 + i * 3],
+            hops: msg.data[10 + i * 3]
+          });
+        }
+        if (this.status.routeStats.routed) {
+          this.log(`route stats: ${this.status.routeStats.serverHops === null ? '-' : this.status.routeStats.serverHops} hops from the server` +
+            (msg.hops !== undefined ? `, ${msg.hops} hops to the server` : '') +
+            `, ${this.status.routeStats.forwarded} relayed, ${this.status.routeStats.dropped} dropped, routes [` +
+            this.status.routeStats.routes.map((r) => `0x${r.dest.toString(16)} via 0x${r.nextHop.toString(16)} (${r.hops})`).join(', ') + ']');
+        } else {
+          this.log('route stats: routed mode disabled');
+        }
+        break;
+
+      case RH_MSG_HISTORY: // >= v2.4.0
+        {
+          const seq = msg.data.readUInt16LE(1);
+          const count = msg.data[3] & ~HISTORY_CHUNK_MORE;
+          const now = Date.now();
+
+          // the 10 bit adc values of all channels are packed
+          const adcLen = Math.ceil(this.channelCount * 10 / 8);
+          const sampleLen = 6 + adcLen;
+
+          for (let i = 0; i < count; i++) {
+            const pos = 4 + i * sampleLen;
+            const age = msg.data.readUInt16LE(pos);
+            const adcRaw = [];
+            for (let chan = 0; chan < this.channelCount; chan++) {
+              const byte = pos + 2 + Math.floor(chan * 10 / 8);
+              adcRaw[chan] = ((msg.data[byte] | (msg.data[byte + 1] << 8)) >> ((chan * 10) % 8)) & 0x03FF;
+            }
+            const temperature = msg.data.readInt16LE(pos + 2 + adcLen);
+            const humidity = msg.data[pos + 4 + adcLen];
+            const batPercent = msg.data[pos + 5 + adcLen];
+
+            this.history.push({
+              seq: (seq + i) % 0xFFFF,
+              time: (age === HISTORY_NO_AGE) ? null : now - age * 60000,
+              adcRaw: adcRaw,
+              temperature: (temperature === HISTORY_NO_TEMP) ? null : temperature / 10,
+              humidity: (humidity === HISTORY_NO_VALUE) ? null : humidity,
+              batPercent: (batPercent === HISTORY_NO_VALUE) ? null : batPercent
+            });
+          }
+          if (this.history.length > HISTORY_MAX_SAMPLES) {
+            this.history.splice(0, this.history.length - HISTORY_MAX_SAMPLES);
+          }
+
+          // the system sends from its oldest sample if the requested one is ahead, e.g.
+          // after a restart with the history in SRAM, so the cursor follows the reply
+          if (seq !== this.historySeq) {
+            this.log(`history: requested #${this.historySeq} is not available, restarting at #${seq}`);
+          }
+          this.historySeq = (seq + count) % 0xFFFF;
+          this.log(`history: ${count} samples from #${seq}`);
+
+          // request the remaining samples after the last chunk of this burst
+          clearTimeout(this.historyTimeout);
+          this.historyTimeout = null;
+          if (msg.data[3] & HISTORY_CHUNK_MORE) {
+            this.historyTimeout = setTimeout(() => {
+              this.historyTimeout = null;
+              this.requestHistory();
+            }, 1000);
+          }
+        }
+        break;
+
+      case RH_MSG_EXT_SETTINGS: // >= v2.4.0
+        this.log('got extended settings');
+        if (!this.settings) {
+          // wait for the main settings
+          break;
+        }
+        this.settings.time = (new Date()).getTime();
+        this.settings.adcOversampling = msg.data[1];
+        this.settings.adcFilterType = msg.data[2];
+        this.settings.adcFilterDepth = msg.data[3];
+        this.settings.pushOnChange = (msg.data[4] === 0x01);
+        this.settings.deadbandAdc = msg.data[5];
+        this.settings.deadbandTemp = msg.data[6] / 10;
+        this.settings.deadbandBattery = msg.data[7];
+        this.settings.heartbeatInterval = msg.data.readUInt16LE(8);
+        if (msg.data.length >= 14) {
+          this.settings.valveMax = msg.data[10];
+          this.settings.valveGap = msg.data.readUInt16LE(11);
+          this.settings.valveOrder = msg.data[13];
+        }
+        if (msg.data.length >= 19) {
+          this.settings.checkAdaptive = (msg.data[14] === 0x01);
+          this.settings.checkIntervalMin = msg.data.readUInt16LE(15);
+          this.settings.checkIntervalMax = msg.data.readUInt16LE(17);
+        }
+        if (msg.data.length >= 22) {
+          this.settings.sensorsWarmup = msg.data.readUInt16LE(19);
+          this.settings.settleTolerance = msg.data[21];
+        }
+        if (msg.data.length >= 23) {
+          this.settings.routeVia = msg.data[22];
+        }
+        break;
+
+      case RH_MSG_SETTINGS_PATCHED: // >= v2.4.0
+        if (msg.data[2] === SETTINGS_PATCH_OK) {
+          this.log(`settings patched, ${msg.data[1]} fields applied`);
+        } else {
+          // the known settings may be wrong now, so they must be loaded again
+          this.log(`settings patched, ${msg.data[1]} fields applied, field 0x${msg.data[2].toString(16)} rejected`);
+          this.settings = null;
+        }
+        break;
+
       case RH_MSG_VERSION:
         clearInterval(this.versionInterval);
         this.versionInterval = null;
         this.softwareVersion = `v${msg.data[1]}.${msg.data[2]}.${msg.data[3]}`;
         this.log('got software version ' + this.softwareVersion);
+
+        // the channel count is send by >= v2.4.0 only
+        this.channelCount = (msg.data.length > 4) ? msg.data[4] : 4;
+        this.status.adcRaw = new Array(this.channelCount).fill('-');
+        this.status.adcVolt = new Array(this.channelCount).fill('-');
+        this.status.on = new Array(this.channelCount).fill(false);
+        this.log(`${this.channelCount} channels`);
         break;
 
       case RH_MSG_PONG:
@@ -0,0 +1,350 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Multi-node channel simulator.
+ *
+ * Runs several nodes sharing one radio channel with a server and measures the
+ * delivery rate against the node count. Each node is a copy of the firmware
+ * built as shared library with the native hal (see src/hal_native.h), loaded
+ * once per node, so all nodes run the real firmware with their own clock,
+ * memory and random generator.
+ *
+ * The server and the nodes are placed on a line with the same distance. With
+ * a radio range each node only reaches the nodes up to this distance and the
+ * farther nodes send in routed mode via the farthest node in range towards the
+ * server. Without a range all nodes reach each other. A frame is lost for a
+ * receiver if another frame in range of the receiver overlaps with it. The
+ * server acknowledges each received frame after a short turnaround. All nodes
+ * are powered on at the same time.
+ *
+ * See the readme for building and running.
+ */
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "rh.h"
+
+#define SIM_MAX_NODES  64
+#define SIM_MAX_AIR    128  // max frames on the air or recently send
+#define SIM_SERVER     0xFF // index of the server as sender
+#define SIM_TURNAROUND 5    // time in milliseconds until the server sends the ack
+#define SIM_TAIL       30   // time in seconds to finish the pending messages after the run
+#define SIM_AIR_KEEP   RH_AIRTIME(HAL_RADIO_MAX_LEN) // time to keep send frames for the collision check
+
+// simulated node
+struct SimNode {
+  void *lib;
+  HalNode *api;
+  uint8_t addr;
+  uint8_t lastId;       // id of the last message send by the node
+  bool lastValid;       // if the node has send a message
+  bool lastCounted;     // if the last message counts for the statistics
+  bool lastDelivered;   // if the last message is delivered to the server
+};
+
+// frame on the air
+struct SimAir {
+  HalRadioFrame frame;
+  uint8_t sender;       // index of the sending node or SIM_SERVER
+  unsigned long start;
+  unsigned long end;
+  bool done;            // the frame is delivered to the receivers
+};
+
+// statistics of one run
+struct SimStats {
+  uint32_t messages;    // messages send by the nodes
+  uint32_t delivered;   // messages received by the server
+  uint32_t hops;        // sum of the hops of the delivered messages
+  uint32_t frames;      // frames send including retries, relayed messages and acks
+  uint32_t lost;        // frames not received by the addressed receiver because of a collision
+};
+
+SimNode simNodes[SIM_MAX_NODES];
+uint8_t simNodeCount = 0;
+
+SimAir simAir[SIM_MAX_AIR];
+uint8_t simAirCount = 0;
+
+SimStats simStats;
+
+const char *simLibPath = "sim/node.so";
+bool simCarrierSense = false;
+uint8_t simRange = 0;
+
+/**
+ * Load a new copy of the node library.
+ * The library is copied to a temporary file first, because loading the same
+ * file again would only return the already loaded copy.
+ */
+bool simLoad (SimNode *node) {
+  char path[] = "/tmp/aws-node-XXXXXX";
+  int fd = mkstemp(path);
+  FILE *src = fopen(simLibPath, "rb");
+  if (fd < 0 || !src) {
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), src)) > 0) {
+    if (write(fd, buf, n) != (ssize_t)n) {
+      break;
+    }
+  }
+  fclose(src);
+  close(fd);
+
+  node->lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  unlink(path);
+  if (!node->lib) {
+    fprintf(stderr, "%s\n", dlerror());
+    return false;
+  }
+  node->api = (HalNode *)dlsym(node->lib, "halNode");
+  return node->api != NULL;
+}
+
+/**
+ * Get the position of a node or the server on the line.
+ */
+int simPos (uint8_t index) {
+  return (index == SIM_SERVER) ? 0 : index + 1;
+}
+
+/**
+ * Check if two nodes or a node and the server are in radio range.
+ */
+bool simInRange (uint8_t a, uint8_t b) {
+  return simRange == 0 || abs(simPos(a) - simPos(b)) <= simRange;
+}
+
+/**
+ * Put a frame on the air.
+ */
+void simTransmit (const HalRadioFrame *frame, uint8_t sender, unsigned long start) {
+  if (simAirCount >= SIM_MAX_AIR) {
+    return;
+  }
+  SimAir *air = &simAir[simAirCount++];
+  air->frame = *frame;
+  air->sender = sender;
+  air->start = start;
+  air->end = start + RH_AIRTIME(frame->len);
+  air->done = false;
+
+  simStats.frames++;
+}
+
+/**
+ * Check if a frame is received by a node or the server.
+ * The sender must be in range and no other frame in range of the receiver
+ * may overlap with the frame.
+ */
+bool simReceived (SimAir *air, uint8_t receiver) {
+  if (!simInRange(air->sender, receiver)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < simAirCount; i++) {
+    SimAir *other = &simAir[i];
+    if (other != air && other->start < air->end && air->start < other->end
+      && (other->sender == receiver || simInRange(other->sender, receiver))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Check if a frame of another sender in range is on the air.
+ */
+bool simChannelActive (uint8_t index, unsigned long now) {
+  for (uint8_t i = 0; i < simAirCount; i++) {
+    SimAir *air = &simAir[i];
+    if (air->sender != index && air->start <= now && now < air->end && simInRange(air->sender, index)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Take the frames send by a node and put them on the air.
+ */
+void simTakeFrames (uint8_t index, unsigned long now, bool counting) {
+  SimNode *node = &simNodes[index];
+  uint8_t headerLen = node->api->routeHeaderLen;
+  HalRadioFrame frame;
+  while (node->api->take(&frame)) {
+    // new message of this node, retries use the same id and relayed messages have another source
+    uint8_t id = headerLen ? frame.data[3] : frame.id;
+    bool own = headerLen ? frame.data[1] == node->addr : true;
+    if (!(frame.flags & RH_FLAGS_ACK) && own && (!node->lastValid || id != node->lastId)) {
+      node->lastId = id;
+      node->lastValid = true;
+      node->lastCounted = counting;
+      node->lastDelivered = false;
+      if (counting) {
+        simStats.messages++;
+      }
+    }
+    simTransmit(&frame, index, now);
+  }
+}
+
+/**
+ * Receive a frame by the server and acknowledge it.
+ */
+void simServerReceive (SimAir *air) {
+  if ((air->frame.flags & RH_FLAGS_ACK) || air->sender == SIM_SERVER) {
+    return;
+  }
+
+  // the source and id of routed messages are in the route header
+  uint8_t headerLen = simNodes[air->sender].api->routeHeaderLen;
+  uint8_t source = headerLen ? air->frame.data[1] : air->frame.from;
+  uint8_t id = headerLen ? air->frame.data[3] : air->frame.id;
+  uint8_t index = source - 0x10;
+  if (index < simNodeCount) {
+    SimNode *node = &simNodes[index];
+    if (node->lastValid && id == node->lastId && !node->lastDelivered) {
+      node->lastDelivered = true;
+      if (node->lastCounted) {
+        simStats.delivered++;
+        simStats.hops += headerLen ? air->frame.data[2] : 0;
+      }
+    }
+  }
+
+  HalRadioFrame ack;
+  ack.from = RH_SERVER_ADDR;
+  ack.to = air->frame.from;
+  ack.id = air->frame.id;
+  ack.flags = RH_FLAGS_ACK;
+  ack.len = 1;
+  ack.data[0] = '!';
+  simTransmit(&ack, SIM_SERVER, air->end + SIM_TURNAROUND);
+}
+
+/**
+ * Deliver the frames which are completely send to the receivers and drop the
+ * frames which are not needed anymore for the collision check.
+ */
+void simDeliver (unsigned long now) {
+  for (uint8_t i = 0; i < simAirCount; i++) {
+    SimAir *air = &simAir[i];
+    if (air->done || air->end > now) {
+      continue;
+    }
+    air->done = true;
+
+    bool received = false;
+    if (air->frame.to == RH_SERVER_ADDR && simReceived(air, SIM_SERVER)) {
+      received = true;
+      simServerReceive(air);
+    }
+    for (uint8_t n = 0; n < simNodeCount; n++) {
+      if (n != air->sender && (air->frame.to == simNodes[n].addr || air->frame.to == RH_BROADCAST_ADDRESS) && simReceived(air, n)) {
+        received = true;
+        simNodes[n].api->inject(air->frame.from, air->frame.to, air->frame.id, air->frame.flags, air->frame.data, air->frame.len);
+      }
+    }
+    if (!received && air->frame.to != RH_BROADCAST_ADDRESS) {
+      simStats.lost++;
+    }
+  }
+
+  uint8_t i = 0;
+  while (i < simAirCount) {
+    if (simAir[i].done && simAir[i].end + SIM_AIR_KEEP <= now) {
+      simAir[i] = simAir[--simAirCount];
+    } else {
+      i++;
+    }
+  }
+}
+
+/**
+ * Run the given number of nodes for the given time.
+ */
+bool simRun (uint8_t nodeCount, unsigned long runTime, uint16_t checkInterval) {
+  memset(&simStats, 0, sizeof(simStats));
+  simAirCount = 0;
+  simNodeCount = nodeCount;
+
+  for (uint8_t n = 0; n < nodeCount; n++) {
+    SimNode *node = &simNodes[n];
+    memset(node, 0, sizeof(SimNode));
+    if (!simLoad(node)) {
+      return false;
+    }
+    node->addr = 0x10 + n;
+
+    // nodes out of range of the server send via the farthest node in range
+    int pos = simPos(n);
+    uint8_t routeVia = RH_BROADCAST_ADDRESS;
+    if (simRange > 0 && pos > simRange) {
+      routeVia = 0x10 + (pos - simRange - 1);
+    }
+    node->api->setup(node->addr, checkInterval, routeVia);
+  }
+
+  for (unsigned long now = 0; now < runTime + SIM_TAIL * 1000UL; now++) {
+    for (uint8_t n = 0; n < nodeCount; n++) {
+      SimNode *node = &simNodes[n];
+      *node->api->channelActive = simCarrierSense && simChannelActive(n, now);
+      while (node->api->millis() <= now) {
+        node->api->step();
+      }
+      simTakeFrames(n, now, now < runTime);
+    }
+    simDeliver(now);
+  }
+
+  for (uint8_t n = 0; n < nodeCount; n++) {
+    dlclose(simNodes[n].lib);
+  }
+  return true;
+}
+
+int main (int argc, char **argv) {
+  unsigned long runTime = 3600000;
+  uint16_t checkInterval = 60;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:i:cr:l:")) != -1) {
+    switch (opt) {
+      case 't': runTime = strtoul(optarg, NULL, 10) * 1000; break;
+      case 'i': checkInterval = strtoul(optarg, NULL, 10); break;
+      case 'c': simCarrierSense = true; break;
+      case 'r': simRange = strtoul(optarg, NULL, 10); break;
+      case 'l': simLibPath = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-t seconds] [-i check interval] [-c] [-r range] [-l node library] [node counts ...]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  printf("nodes  messages  delivered   rate  hops  frames    lost\n");
+  const char *defaultCounts[] = { "1", "2", "4", "8", "16" };
+  int countArgs = (optind < argc) ? argc - optind : 5;
+  for (int i = 0; i < countArgs; i++) {
+    int nodeCount = atoi((optind < argc) ? argv[optind + i] : defaultCounts[i]);
+    if (nodeCount < 1 || nodeCount > SIM_MAX_NODES) {
+      fprintf(stderr, "node count must be 1 to %d\n", SIM_MAX_NODES);
+      return 1;
+    }
+    if (!simRun(nodeCount, runTime, checkInterval)) {
+      fprintf(stderr, "failed to load %s\n", simLibPath);
+      return 1;
+    }
+    printf("%5d  %8u  %9u  %4.1f%%  %4.2f  %6u  %6u\n", nodeCount, simStats.messages, simStats.delivered,
+      simStats.messages ? 100.0 * simStats.delivered / simStats.messages : 0.0,
+      simStats.delivered ? (double)simStats.hops / simStats.delivered : 0.0, simStats.frames, simStats.lost);
+    fflush(stdout);
+  }
+
+  return 0;
+}
@@ -9,25 +9,63 @@
 #include "actions.h"
 
 #include "rh.h"
+#include "sampling.h"
+#include "scheduler.h"
+#include "valves.h"
+
+// queue of the blink codes to show
+uint16_t blinkQueue[BLINK_QUEUE_LEN][3];
+uint8_t blinkQueueHead = 0;
+uint8_t blinkQueueCount = 0;
+
+// current step of the blink code at the head of the queue
+// even steps turn the LED on, odd steps turn the LED off
+uint8_t blinkStep = 0;
 
 /**
- * Blink the LED with a tripple blink code.
+ * Queue a tripple blink code for the LED.
+ * The LED is driven by the LED task, so this returns immediately.
+ * If the queue is full the blink code is dropped.
  * @param t1 Time 1 in ms.
  * @param t2 Time 2 in ms (optional).
  * @param t3 Time 3 in ms (optional).
  */
 void blinkCode (uint16_t t1, uint16_t t2, uint16_t t3) {
+  if (blinkQueueCount >= BLINK_QUEUE_LEN) {
+    return;
+  }
+
+  uint16_t *code = blinkQueue[(blinkQueueHead + blinkQueueCount) % BLINK_QUEUE_LEN];
+  code[0] = t1;
+  code[1] = t2;
+  code[2] = t3;
+  blinkQueueCount++;
+
+  // start the LED task if it is not already running
+  if (!schedulerIsSet(TASK_LED)) {
+    schedulerSet(TASK_LED, millis());
+  }
+}
+
+/**
+ * Blink the LED with a tripple blink code and wait until it's done.
+ * This blocks the whole system and should only be used at startup time.
+ * @param t1 Time 1 in ms.
+ * @param t2 Time 2 in ms (optional).
+ * @param t3 Time 3 in ms (optional).
+ */
+void blinkCodeBlocking (uint16_t t1, uint16_t t2, uint16_t t3) {
   digitalWrite(LED_PIN, HIGH);
   delay(t1);
   digitalWrite(LED_PIN, LOW);
   if (t2 > 0) {
-    delay(100);
+    delay(BLINK_PAUSE);
     digitalWrite(LED_PIN, HIGH);
     delay(t2);
     digitalWrite(LED_PIN, LOW);
   }
   if (t3 > 0) {
-    delay(100);
+    delay(BLINK_PAUSE);
     digitalWrite(LED_PIN, HIGH);
     delay(t3);
     digitalWrite(LED_PIN, LOW);
@@ -35,28 +73,57 @@ void blinkCode (uint16_t t1, uint16_t t2, uint16_t t3) {
 }
 
 /**
- * Turns the valve of the given channel on if no other valve is currently turned on.
- *
- * Returns `true` if the valve is turned on, `false` if it is not turned on
- * because an other valve is already on.
+ * Task to advance the blink code at the head of the queue by one step.
  */
-bool turnValveOn (uint8_t chan) {
-  // check if we can turn on
-  if (channelOn[0] || channelOn[1] || channelOn[2] || channelOn[3]) {
-    // one channel is on
-    return false;
+void taskLed (uint8_t task, unsigned long now) {
+  uint16_t *code = blinkQueue[blinkQueueHead];
+
+  if (blinkStep % 2 == 0) {
+    // turn the LED on for the time of the current blink
+    digitalWrite(LED_PIN, HIGH);
+    schedulerSet(TASK_LED, now + code[blinkStep / 2]);
+    blinkStep++;
+    return;
+  }
+
+  // turn the LED off
+  digitalWrite(LED_PIN, LOW);
+  blinkStep++;
+
+  // check if there is a next blink in this code
+  if (blinkStep < 6 && code[blinkStep / 2] > 0) {
+    schedulerSet(TASK_LED, now + BLINK_PAUSE);
+    return;
+  }
+
+  // blink code done, remove it from the queue
+  blinkStep = 0;
+  blinkQueueHead = (blinkQueueHead + 1) % BLINK_QUEUE_LEN;
+  blinkQueueCount--;
+
+  // start the next blink code if there is one
+  if (blinkQueueCount > 0) {
+    schedulerSet(TASK_LED, now + BLINK_CODE_PAUSE);
   }
+}
 
+/**
+ * Turns the valve of the given channel on.
+ * The valves are opened by the queue in valves.cpp only, which checks how many
+ * valves may be open at the same time.
+ */
+void turnValveOn (uint8_t chan) {
   // turn the valve pin on
   digitalWrite(valvePins[chan], HIGH);
 
   // set marker that this channel is on
-  channelOn[chan] = true;
+  channelOn |= CHANNEL_BIT(chan);
+
+  // forget the old sensor values to not trigger again before the water arrived
+  samplingReset(chan);
 
   // send RadioHead message
   rhSendData(RH_MSG_CHANNEL_STATE);
-
-  return true;
 }
 
 /**
@@ -67,7 +134,10 @@ void turnValveOff (uint8_t chan) {
   digitalWrite(valvePins[chan], LOW);
 
   // set marker that this channel is off
-  channelOn[chan] = false;
+  channelOn &= ~CHANNEL_BIT(chan);
+
+  // the next waiting valve is opened after the gap
+  valveQueueClosed(millis());
 
   // send RadioHead message
   rhSendData(RH_MSG_CHANNEL_STATE);
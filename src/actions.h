@@ -18,8 +18,18 @@
 
 #define BLINK_CODE_RH_RECV           BLINK_VERY_SHORT, BLINK_VERY_SHORT
 
+// pause between the blinks of one blink code
+#define BLINK_PAUSE 100
+// pause between two queued blink codes
+#define BLINK_CODE_PAUSE 300
+
+// number of blink codes which can be queued
+#define BLINK_QUEUE_LEN 4
+
 void blinkCode (uint16_t t1, uint16_t t2 = 0, uint16_t t3 = 0);
-bool turnValveOn (uint8_t chan);
+void blinkCodeBlocking (uint16_t t1, uint16_t t2 = 0, uint16_t t3 = 0);
+void taskLed (uint8_t task, unsigned long now);
+void turnValveOn (uint8_t chan);
 void turnValveOff (uint8_t chan);
 
 #endif
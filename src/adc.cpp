@@ -0,0 +1,143 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Interrupt-driven adc sequencer for the sensor and battery channels.
+ *
+ * All channels of a sequence are read in the background using the adc
+ * conversion complete interrupt. Each channel is read multiple times and the
+ * average is stored in adcValues[] or batteryRaw.
+ */
+
+#include "adc.h"
+
+volatile bool adcDone = false;
+
+// state of the running sequence
+volatile uint16_t adcChannelMask = 0;
+volatile uint8_t adcChannel = 0;
+volatile uint8_t adcSamples = 1;
+volatile uint8_t adcSampleCount = 0;
+volatile uint16_t adcSum = 0;
+
+/**
+ * Get the adc input (mux) of a channel in the sequence.
+ */
+uint8_t adcMux (uint8_t chan) {
+  if (chan == ADC_SEQ_BATTERY) {
+    return BATTERY_ADC - A0;
+  }
+  return sensorAdcPins[chan] - A0;
+}
+
+/**
+ * Select the next channel of the sequence and start the conversion.
+ * Sets adcDone if there is no more channel.
+ */
+void adcNextChannel () {
+  while (adcChannel <= ADC_SEQ_BATTERY && !(adcChannelMask & (1 << adcChannel))) {
+    adcChannel++;
+  }
+
+  if (adcChannel > ADC_SEQ_BATTERY) {
+    // all channels read
+    ADCSRA &= ~(1<<ADIE);
+    adcChannelMask = 0;
+    adcDone = true;
+    return;
+  }
+
+  adcSum = 0;
+  adcSampleCount = 0;
+  ADMUX = (ADMUX & 0xF0) | adcMux(adcChannel);
+  ADCSRA |= (1<<ADSC);
+}
+
+/**
+ * Conversion complete interrupt.
+ */
+ISR (ADC_vect) {
+  adcSum += ADC;
+  adcSampleCount++;
+
+  if (adcSampleCount < adcSamples) {
+    // next conversion of the same channel
+    ADCSRA |= (1<<ADSC);
+    return;
+  }
+
+  // store the average with rounding
+  uint16_t value = (adcSum + adcSamples / 2) / adcSamples;
+  if (adcChannel == ADC_SEQ_BATTERY) {
+    #if BAT_ENABLED == 1
+      batteryRaw = value;
+    #endif
+  } else {
+    adcValues[adcChannel] = value;
+  }
+
+  adcChannel++;
+  adcNextChannel();
+}
+
+/**
+ * Init the adc.
+ * Must be called once at startup time.
+ * The adc is disabled afterwards.
+ */
+void adcInit () {
+  ADMUX =
+    (0 << ADLAR) | // right adjust result, 10 bit
+    (0 << REFS1) | // Sets ref. voltage to AVCC, bit 1
+    (1 << REFS0);  // Sets ref. voltage to AVCC, bit 0
+  ADCSRA =
+    (1 << ADPS2) | // set prescaler to 128 (125 kHz adc clock), bit 2
+    (1 << ADPS1) | // set prescaler to 128 (125 kHz adc clock), bit 1
+    (1 << ADPS0);  // set prescaler to 128 (125 kHz adc clock), bit 0
+
+  // disable the digital input buffers of the used adc pins (A6 and A7 have none)
+  for (uint8_t chan = 0; chan <= ADC_SEQ_BATTERY; chan++) {
+    uint8_t mux = adcMux(chan);
+    if (mux < 6) {
+      DIDR0 |= (1 << mux);
+    }
+  }
+}
+
+/**
+ * Enable the adc.
+ */
+void adcEnable () {
+  ADCSRA |= (1<<ADEN);
+}
+
+/**
+ * Disable the adc for powersaving.
+ */
+void adcDisable () {
+  ADCSRA &= ~(1<<ADEN);
+}
+
+/**
+ * Start reading all channels of the mask in the background.
+ * adcDone is set when all channels are read.
+ * @param channelMask One bit for each sensor channel, bit ADC_SEQ_BATTERY for the battery.
+ * @param samples     Number of readings per channel which are averaged.
+ */
+void adcStart (uint16_t channelMask, uint8_t samples) {
+  adcDone = false;
+  adcChannelMask = channelMask;
+  adcChannel = 0;
+  adcSamples = (samples == 0) ? 1 : samples;
+
+  ADCSRA |= (1<<ADIF) | (1<<ADIE); // clear a pending interrupt and enable the interrupt
+  adcNextChannel();
+}
+
+/**
+ * Check if a sequence is running.
+ */
+bool adcBusy () {
+  return adcChannelMask != 0;
+}
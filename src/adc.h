@@ -0,0 +1,23 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __ADC_H__
+#define __ADC_H__
+
+#include "globals.h"
+
+// bit in the channel mask for the battery adc, after the sensor channels
+#define ADC_SEQ_BATTERY CHANNEL_COUNT
+
+// marker set by the adc interrupt when all channels are read
+extern volatile bool adcDone;
+
+void adcInit ();
+void adcEnable ();
+void adcDisable ();
+void adcStart (uint16_t channelMask, uint8_t samples);
+bool adcBusy ();
+
+#endif
@@ -9,19 +9,21 @@
 #ifndef __CONFIG_H__
 #define __CONFIG_H__
 
-#include <Arduino.h>
+/*
+ * Channels
+ */
+// Number of watering channels (1 to 8)
+// Each channel needs a valve pin, a button pin and a sensor adc pin.
+// The eeprom is reset if this is changed.
+#define CHANNEL_COUNT 4
 
 /*
  * Digital pins
  */
-#define VALVE_0_PIN        2
-#define VALVE_1_PIN        3
-#define VALVE_2_PIN        4
-#define VALVE_3_PIN        5
-#define VALVE_0_BUTTON_PIN 6
-#define VALVE_1_BUTTON_PIN 7
-#define VALVE_2_BUTTON_PIN 8
-#define VALVE_3_BUTTON_PIN 9
+// one pin per channel
+#define VALVE_PINS         2, 3, 4, 5
+#define VALVE_BUTTON_PINS  6, 7, 8, 9
+
 #define SENSORS_ACTIVE_PIN 10
 #define LED_PIN            13
 #define TEMP_SENSOR_PIN    14
@@ -32,14 +34,46 @@
 #define RH_RX_PIN          12
 #define RH_PTT_PIN         EEPROM_RESET_PIN // unused but needed ... set to EEPROM_RESET_PIN because this is only used at early startup -> no conflicts :-)
 
+// chip select and interrupt pin of a SPI radio (RH_DRIVER 69 or 95)
+// The SPI bus uses the pins 11, 12 and 13 and the interrupt pin must be
+// pin 2 or 3, so the valve and LED pins have to be moved to other pins.
+#define RH_RF_CS_PIN       SS
+#define RH_RF_INT_PIN      2
+
 /*
  * Analog pins
  */
-#define SENSOR_0_ADC   A4
-#define SENSOR_1_ADC   A5
-#define SENSOR_2_ADC   A6
-#define SENSOR_3_ADC   A7
-#define BATTERY_ADC    A2
+// one pin per channel
+#define SENSOR_ADC_PINS A4, A5, A6, A7
+#define BATTERY_ADC     A2
+
+/*
+ * Sensor values
+ */
+// Number of the last adc values of each channel stored for the median filter (max 8)
+#define ADC_HISTORY_LEN 5
+
+// Use the adc noise reduction sleep mode while reading the adc values (1 enabled, 0 disabled)
+// Timer0 and the RadioHead timer are stopped during the conversions, so the
+// time runs behind about 2 ms per check and receiving messages may fail then.
+#define ADC_NOISE_REDUCTION 0
+
+// Distance below the trigger value in adc steps where the adaptive check
+// interval is shortened down to the min interval
+#define CHECK_ADAPTIVE_RANGE 100
+
+// Number of checks with the min adaptive check interval after a watering
+#define CHECK_ADAPTIVE_FAST 3
+
+// Time in milliseconds between two readings of the sensors while waiting for
+// them to settle after turning them on
+#define SENSORS_SETTLE_INTERVAL 10
+
+// Time in milliseconds to delay the adc read if a settle reading is still running
+#define SENSORS_READ_RETRY 2
+
+// Max warmup time of the sensors in milliseconds
+#define SENSORS_WARMUP_MAX 5000
 
 /*
  * Temperature (and humidity) sensor
@@ -67,14 +101,129 @@
 #define RH_SERVER_ADDR 0x01
 
 
-// RadioHead bitrate in bit/s
+// RadioHead driver
+//  0 for RH_ASK, a simple 433 MHz ASK transmitter and receiver
+//  69 for RH_RF69, a HopeRF RFM69 packet radio on the SPI bus
+//  95 for RH_RF95, a HopeRF RFM95/96/97/98 LoRa radio on the SPI bus
+//  1 for RH_Serial, a wired connection on the serial port (e.g. RS485)
+#define RH_DRIVER 0
+
+// RadioHead bitrate in bit/s of the ASK driver
 #define RH_SPEED 2000
 
+// Frequency in MHz and transmit power in dBm of the RF69 and RF95 drivers
+#define RH_RF_FREQUENCY 868.0
+#define RH_RF_TX_POWER  13
+
+// Baud rate of the serial driver
+#define RH_SERIAL_SPEED 38400
+
+// Max length of a message in bytes, limited to the max length of the driver.
+// Longer messages speed up the history download, but each slot of the
+// transmit queue needs this RAM.
+#define RH_BUF_LEN 28
+
 // Number of retries to send a message. If set to 0, each message will only ever be sent once.
 #define RH_SEND_RETRIES 3
 
-// Timeout for an ack.
-#define RH_SEND_TIMEOUT 200
+// Time in milliseconds the server may need to answer with an ack.
+// The ack timeout is this plus the time to transmit the ack with the driver.
+#define RH_SEND_TIMEOUT_MARGIN 100
+
+// Interval in milliseconds to check for received messages.
+#define RH_POLL_INTERVAL 10
+
+// Number of messages which can be queued for sending.
+#define RH_TX_QUEUE_LEN 4
+
+// Number of messages which are received at once before handling them.
+#define RH_RX_QUEUE_LEN 3
+
+// Number of senders whose last message id is kept to detect retransmissions,
+// each needs 2 bytes RAM. The oldest sender is replaced if all are used.
+#define RH_RX_SEEN_LEN 4
+
+// Duty cycle limit of the transmitter in tenth of a percent, e.g. 10 for the
+// 1 % of the 868 MHz band in Europe. 0 to disable the limit.
+// Only enabled by default for the 868 MHz packet radios, the ASK radio had no
+// limit before and the serial connection doesn't need one.
+#if RH_DRIVER == 69 || RH_DRIVER == 95
+  #define RH_DUTY_CYCLE 10
+#else
+  #define RH_DUTY_CYCLE 0
+#endif
+
+// Time in seconds of the sliding window the duty cycle is measured over.
+#define RH_DUTY_CYCLE_WINDOW 3600
+
+// Part of the duty cycle budget in percent which is reserved for valve state
+// changes and replies. Pushed values are deferred if the rest is used up.
+#define RH_DUTY_CYCLE_RESERVE 20
+
+// Check if the channel is in use by another node before each transmission and
+// back off for a random time if so. Only supported by drivers with channel
+// activity detection (RH_RF95), ignored by the others.
+// (1 enabled, 0 disabled)
+#define RH_CARRIER_SENSE 1
+
+// Max number of times a transmission is put back because the channel is in use.
+#define RH_CARRIER_SENSE_TRIES 8
+
+// Max exponent of the randomized exponential backoff. The random range of the
+// backoff is doubled with each try up to 2^RH_BACKOFF_MAX_EXP times the base.
+#define RH_BACKOFF_MAX_EXP 4
+
+// Max random time in milliseconds to delay the first check and temperature
+// read, so nodes powered on together get different schedule phases. The delay
+// is also limited to the check interval. The random generator is seeded from
+// the own address. Kept short to not delay the first check much after power-on,
+// the phases keep drifting apart by SCHEDULE_JITTER_CYCLE afterwards. Raise it
+// up to the check interval for many nodes powered on together.
+#define SCHEDULE_JITTER_START 30000
+
+// Max random time in milliseconds to delay the start message.
+#define RH_START_JITTER 5000
+
+// Routed mode for nodes out of range of the server. The messages are relayed
+// by other nodes in the message format of RadioHead's RHRouter. The next hop
+// to the server is set in the settings, the routes back are learned from the
+// relayed messages. Needs 5 bytes more in each message.
+// (1 enabled, 0 disabled)
+#define RH_ROUTING 0
+
+// Number of learned routes, each needs 3 bytes RAM.
+#define RH_ROUTES 6
+
+// Max number of hops of a routed message.
+#define RH_MAX_HOPS 4
+
+// Max random time in milliseconds added to each check and temperature read
+// interval, so the phases of the nodes keep moving against each other.
+#define SCHEDULE_JITTER_CYCLE 2000
+
+// Push all current values in one telemetry message instead of separate
+// messages for the sensor values, battery and temperature sensor data.
+// (1 enabled, 0 disabled)
+#define RH_PUSH_TELEMETRY 1
+
+/*
+ * Power saving
+ */
+// Sleep mode between the scheduled events
+//  0 for no sleep
+//  1 for idle sleep, the radio receiver stays active all the time
+//  2 for power-down sleep, the radio receiver is only active for RH_LISTEN_TIME after each send
+// While the adc is reading the sensors, idle sleep (or the adc noise reduction
+// mode) is used in all modes, since the adc clock stops in power-down.
+#define POWERSAVE_MODE 1
+
+// Max time in milliseconds of one power-down sleep.
+// Wake ups by a button press may let the time run ahead up to this value.
+// 16, 32, 64, 128, 256, 512, 1024 or 2048
+#define POWERSAVE_MAX_POWER_DOWN 256
+
+// Time in milliseconds to listen for messages after each send in power-down mode.
+#define RH_LISTEN_TIME 2000
 
 /*
  * Battery
@@ -86,4 +235,16 @@
 #define BAT_ADC_LOW  593 // 2.9V # 1023 * 2.9V / 5V
 #define BAT_ADC_FULL 859 // 4.2V # 1023 * 4.2V / 5V
 
+/*
+ * History
+ */
+// Number of samples of the sensor values kept in SRAM, one sample after each check.
+// Each sample needs 13 bytes. 0 disables the history.
+#define HISTORY_LEN 12
+
+// Keep the history in the unused EEPROM after the settings instead of SRAM,
+// so it survives a restart. HISTORY_LEN is ignored then.
+// (1 enabled, 0 disabled)
+#define HISTORY_EEPROM 0
+
 #endif
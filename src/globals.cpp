@@ -12,23 +12,21 @@
 Settings settings;
 
 
-volatile bool channelTurnOn[4]; // volatile to use this inside a ISR
-volatile unsigned long channelTurnOffTime[4];
-unsigned long adcNextReadTime;
-unsigned long tempSensorNextReadTime;
+volatile ChannelMask channelTurnOn = 0; // volatile to use this inside a ISR
+volatile ChannelMask channelTurnOff = 0; // volatile to use this inside a ISR
 
-volatile bool channelOn[4];
-uint16_t adcValues[4] = {0, 0, 0, 0};
-float temperature = -99;
-float humidity = -99;
+volatile ChannelMask channelOn = 0;
+uint16_t adcValues[CHANNEL_COUNT];
+int16_t temperature = TEMP_INVALID;
+int16_t humidity = TEMP_INVALID;
 
 #if BAT_ENABLED == 1
   uint16_t batteryRaw;
 #endif
 
 bool tempSwitchOn = false;
-float tempSwitchTriggerValueHigh = 32;
-float tempSwitchTriggerValueLow = 28;
+int16_t tempSwitchTriggerValueHigh = 3200;
+int16_t tempSwitchTriggerValueLow = 2800;
 
 bool pauseAutomatic;
 
@@ -37,4 +35,6 @@ bool pauseAutomatic;
 #elif TEMP_SENSOR_TYPE == 1820
   OneWire oneWire(TEMP_SENSOR_PIN);
   DallasTemperature ds1820(&oneWire);
+  DeviceAddress ds1820Address; // cached ROM address of the first sensor on the bus
+  bool ds1820AddressValid = false;
 #endif
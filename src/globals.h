@@ -7,40 +7,55 @@
 #define __GLOBALS_H__
 
 #include "config.h"
-
-#include <Arduino.h>
-#include <SPI.h>
-#if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
-  #include <DHTStable.h>
-#elif TEMP_SENSOR_TYPE == 1820
-  #include <OneWire.h>
-  #include <DallasTemperature.h>
-#endif
-#include <PinChangeInterrupt.h>
+#include "hal.h"
 
 // version number of the software
 #define SOFTWARE_VERSION_MAJOR 2
-#define SOFTWARE_VERSION_MINOR 3
-#define SOFTWARE_VERSION_PATCH 2
+#define SOFTWARE_VERSION_MINOR 4
+#define SOFTWARE_VERSION_PATCH 0
 
 // version of the eeporm data model; must be increased if the data model changes
-#define EEPROM_VERSION 5
+// the channel count is part of it, since the settings depend on it
+#define EEPROM_VERSION (13 | ((CHANNEL_COUNT - 1) << 5))
 
 // eeprom addresses
 #define EEPROM_ADDR_VERSION  0 // 1 byte
-#define EEPROM_ADDR_SETTINGS 1 // many bytes
+#define EEPROM_ADDR_SETTINGS 1 // SETTINGS_SLOTS slots
+#define EEPROM_ADDR_HISTORY  (EEPROM_ADDR_SETTINGS + SETTINGS_SLOTS * sizeof(SettingsSlot)) // all remaining bytes
+
+// number of slots for the settings in the eeprom, used in rotation to spread the writes
+#define SETTINGS_SLOTS 4
+
+#if CHANNEL_COUNT < 1 || CHANNEL_COUNT > 8
+  #error CHANNEL_COUNT must be 1 to 8!
+#endif
 
 // array for dynamic access to defined pins
-const uint8_t valvePins[4] = { VALVE_0_PIN, VALVE_1_PIN, VALVE_2_PIN, VALVE_3_PIN };
-const uint8_t buttonPins[4] = { VALVE_0_BUTTON_PIN, VALVE_1_BUTTON_PIN, VALVE_2_BUTTON_PIN, VALVE_3_BUTTON_PIN };
-const uint8_t sensorAdcPins[4] = { SENSOR_0_ADC, SENSOR_1_ADC, SENSOR_2_ADC, SENSOR_3_ADC };
+const uint8_t valvePins[] = { VALVE_PINS };
+const uint8_t buttonPins[] = { VALVE_BUTTON_PINS };
+const uint8_t sensorAdcPins[] = { SENSOR_ADC_PINS };
+static_assert(sizeof(valvePins) == CHANNEL_COUNT, "VALVE_PINS needs one pin per channel");
+static_assert(sizeof(buttonPins) == CHANNEL_COUNT, "VALVE_BUTTON_PINS needs one pin per channel");
+static_assert(sizeof(sensorAdcPins) == CHANNEL_COUNT, "SENSOR_ADC_PINS needs one pin per channel");
+
+// bitmask with one bit per channel
+typedef uint8_t ChannelMask;
+#define CHANNEL_BIT(chan) ((ChannelMask)(1 << (chan)))
+#define CHANNEL_MASK_ALL ((ChannelMask)(0xFF >> (8 - CHANNEL_COUNT)))
+
+/**
+ * Macros to set or clear the bit of a channel in a mask which is also changed
+ * inside an ISR.
+ */
+#define channelMaskSet(mask, chan) ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { mask |= CHANNEL_BIT(chan); }
+#define channelMaskClear(mask, chan) ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { mask &= ~CHANNEL_BIT(chan); }
 
 
 // structure of the settings stored in the eeprom and loaded at runtime
 struct Settings {
-  bool channelEnabled[4];      // indicator if the channel is enabled or not
-  uint16_t adcTriggerValue[4]; // minimum adc value which will trigger the watering
-  uint16_t wateringTime[4];    // watering time in seconds
+  ChannelMask channelEnabled;  // bitmask of the enabled channels
+  uint16_t adcTriggerValue[CHANNEL_COUNT]; // minimum adc value which will trigger the watering
+  uint16_t wateringTime[CHANNEL_COUNT]; // watering time in seconds
   uint16_t checkInterval;      // adc check interval in seconds
   uint16_t tempSensorInterval; // temperature sensor read interval in seconds
   bool sendAdcValuesThroughRH; // send all adc values through RadioHead or not
@@ -51,8 +66,35 @@ struct Settings {
   int8_t tempSwitchTriggerValue; // value where to trigger the temperature switch
   uint8_t tempSwitchHystTenth; // hysteresis of the temperature switch in tenth of the value (10 = 0,1)
   bool tempSwitchInverted;     // if the switch will be inverted (default temp>value = on)
+  uint8_t adcOversampling;     // number of adc readings per channel and check which are averaged
+  uint8_t adcFilterType;       // filter for the adc values (0 none, 1 median, 2 ewma)
+  uint8_t adcFilterDepth;      // number of values for the median filter or weight 1/n of new values for the ewma filter
+  bool pushOnChange;           // push the values only if they changed by more than the deadbands
+  uint8_t deadbandAdc;         // deadband of the adc values in adc steps
+  uint8_t deadbandTempTenth;   // deadband of the temperature and humidity in tenth of the value
+  uint8_t deadbandBattery;     // deadband of the battery in percent
+  uint16_t heartbeatInterval;  // max time in seconds without a push if pushing on change (0 = disabled)
+  uint8_t valveMax;            // max number of valves open at the same time
+  uint16_t valveGap;           // time in seconds after a valve is closed before the next one is opened
+  uint8_t valveOrder;          // order of the waiting channels (0 fifo, 1 driest first)
+  bool checkAdaptive;          // adapt the check interval to the trend of the adc values
+  uint16_t checkIntervalMin;   // shortest adaptive check interval in seconds
+  uint16_t checkIntervalMax;   // longest adaptive check interval in seconds
+  uint16_t sensorsWarmup;      // max time in milliseconds the sensors are turned on before reading the adc
+  uint8_t settleTolerance;     // max difference of two readings of a settled sensor (0 = always wait the warmup time)
+  uint8_t routeVia;            // next hop to the server in routed mode (RH_BROADCAST_ADDRESS = directly to the server)
 };
 
+// slot of the settings in the eeprom
+struct SettingsSlot {
+  uint8_t seq;       // sequence number, increased on each save
+  Settings settings;
+  uint16_t crc;      // crc16 of the sequence number and the settings
+};
+
+// marker for an invalid temperature or humidity value (-99.00)
+#define TEMP_INVALID -9900
+
 /**
  * Macro to check the time for time-based events.
  * If a is greater than or equal to b this returns true, otherwise false.
@@ -64,23 +106,21 @@ struct Settings {
 extern Settings settings;
 
 
-extern volatile bool channelTurnOn[4]; // volatile to use this inside a ISR
-extern volatile unsigned long channelTurnOffTime[4];
-extern unsigned long adcNextReadTime;
-extern unsigned long tempSensorNextReadTime;
+extern volatile ChannelMask channelTurnOn; // volatile to use this inside a ISR
+extern volatile ChannelMask channelTurnOff; // volatile to use this inside a ISR
 
-extern volatile bool channelOn[4];
-extern uint16_t adcValues[4];
-extern float temperature;
-extern float humidity;
+extern volatile ChannelMask channelOn;
+extern uint16_t adcValues[CHANNEL_COUNT];
+extern int16_t temperature; // in hundredth of a degree
+extern int16_t humidity;    // in hundredth of a percent
 
 #if BAT_ENABLED == 1
   extern uint16_t batteryRaw;
 #endif
 
 extern bool tempSwitchOn;
-extern float tempSwitchTriggerValueHigh;
-extern float tempSwitchTriggerValueLow;
+extern int16_t tempSwitchTriggerValueHigh;
+extern int16_t tempSwitchTriggerValueLow;
 
 extern bool pauseAutomatic;
 
@@ -88,6 +128,8 @@ extern bool pauseAutomatic;
   extern DHTStable dhtSensor;
 #elif TEMP_SENSOR_TYPE == 1820
   extern DallasTemperature ds1820;
+  extern DeviceAddress ds1820Address;
+  extern bool ds1820AddressValid;
 #endif
 
 #endif
@@ -0,0 +1,57 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Hardware abstraction layer.
+ *
+ * All hardware related headers are included here. On the AVR these are the
+ * Arduino core, the AVR libc and the used libraries. For the native build
+ * (HAL_NATIVE) the same API is provided by fakes running on the host, so
+ * the firmware sources don't need to know where they run.
+ */
+
+#ifndef __HAL_H__
+#define __HAL_H__
+
+#include "config.h"
+
+#ifdef HAL_NATIVE
+  #include "hal_native.h"
+#else
+  #include <Arduino.h>
+  #include <stddef.h>
+  #include <SPI.h>
+  #include <EEPROM.h>
+  #include <avr/power.h>
+  #include <avr/sleep.h>
+  #include <avr/wdt.h>
+  #include <util/atomic.h>
+  #include <util/crc16.h>
+  #include <PinChangeInterrupt.h>
+  #if RH_DRIVER == 0
+    #include <RH_ASK.h>
+  #elif RH_DRIVER == 69
+    #include <RH_RF69.h>
+  #elif RH_DRIVER == 95
+    #include <RH_RF95.h>
+  #elif RH_DRIVER == 1
+    #include <RH_Serial.h>
+  #endif
+  #include <RHDatagram.h>
+  #include <RHReliableDatagram.h> // for the RH_FLAGS_ACK definition only
+  #if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
+    #include <DHTStable.h>
+  #elif TEMP_SENSOR_TYPE == 1820
+    #include <OneWire.h>
+    #include <DallasTemperature.h>
+  #endif
+
+  // symbols of the linker script and avr-libc describing the memory layout
+  extern char __data_start;
+  extern char __heap_start;
+  extern char __data_load_end;
+  extern char *__brkval;
+#endif
+
+#endif
@@ -0,0 +1,419 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Fakes of the hardware API for the native build on the host.
+ */
+
+#ifdef HAL_NATIVE
+
+#include "hal.h"
+
+#include <stdio.h>
+#include "loop.h"
+#include "rh.h"
+#include "settings.h"
+#include "setup.h"
+
+/*
+ * Virtual clock
+ * The millisecond counter has the name of the Arduino core counter, so the
+ * sleep code can correct it the same way as on the AVR.
+ */
+volatile unsigned long timer0_millis = 0;
+
+unsigned long millis () {
+  return timer0_millis;
+}
+
+unsigned long micros () {
+  return timer0_millis * 1000;
+}
+
+void delay (unsigned long ms) {
+  halAdvance(ms);
+}
+
+void delayMicroseconds (unsigned int us) {
+  // too short for the virtual clock
+}
+
+/*
+ * Pins and adc
+ */
+uint8_t halPins[HAL_PIN_COUNT];
+void (*halPcintHandlers[HAL_PIN_COUNT])(void);
+uint16_t halAnalogValues[8];
+
+volatile uint8_t ADMUX;
+volatile uint8_t ADCSRA;
+volatile uint16_t ADC;
+volatile uint8_t DIDR0;
+volatile uint8_t ACSR;
+volatile uint8_t MCUSR;
+volatile uint8_t WDTCSR;
+
+void pinMode (uint8_t pin, uint8_t mode) {
+  if (mode == INPUT_PULLUP) {
+    halPins[pin] = HIGH;
+  }
+}
+
+void digitalWrite (uint8_t pin, uint8_t val) {
+  halPins[pin] = val;
+}
+
+int digitalRead (uint8_t pin) {
+  return halPins[pin];
+}
+
+void attachPCINT (uint8_t pcintNum, void (*userFunc)(void), uint8_t mode) {
+  halPcintHandlers[pcintNum] = userFunc;
+}
+
+/**
+ * Simulate a button press by calling the PCINT handler of the pin.
+ */
+void halPressButton (uint8_t pin) {
+  if (halPcintHandlers[pin]) {
+    halPcintHandlers[pin]();
+  }
+}
+
+// hold the started adc conversion, so it's still running in the next passes
+bool halAdcHold = false;
+// input of the running adc conversion, latched at the start like on the avr
+int8_t halAdcMux = -1;
+
+/**
+ * Complete all started adc conversions instantly, unless they are on hold.
+ */
+void halAdcProcess () {
+  while ((ADCSRA & (1 << ADEN)) && (ADCSRA & (1 << ADSC))) {
+    if (halAdcMux < 0) {
+      halAdcMux = ADMUX & 0x07;
+    }
+    if (halAdcHold) {
+      return;
+    }
+    ADC = halAnalogValues[halAdcMux];
+    halAdcMux = -1;
+    ADCSRA &= ~(1 << ADSC);
+    if (ADCSRA & (1 << ADIE)) {
+      halAdcVect();
+    }
+  }
+}
+
+/**
+ * Advance the virtual clock.
+ */
+void halAdvance (unsigned long ms) {
+  halAdcProcess();
+  timer0_millis += ms;
+}
+
+// state of the random generator, own per node like in avr-libc
+unsigned long halRandomState = 1;
+
+long random (long howbig) {
+  if (howbig == 0) {
+    return 0;
+  }
+  // minimal standard generator of Park and Miller like avr-libc uses
+  long x = halRandomState;
+  if (x == 0) {
+    x = 123459876L;
+  }
+  x = 16807L * (x % 127773L) - 2836L * (x / 127773L);
+  if (x < 0) {
+    x += 0x7FFFFFFFL;
+  }
+  halRandomState = x;
+  return x % howbig;
+}
+
+long random (long howsmall, long howbig) {
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed (unsigned long seed) {
+  // a seed of 0 is ignored like in the Arduino core
+  if (seed != 0) {
+    halRandomState = seed;
+  }
+}
+
+void cli () {}
+void sei () {}
+
+/*
+ * Sleep, power and watchdog
+ */
+uint8_t halSleepMode = SLEEP_MODE_IDLE;
+
+void set_sleep_mode (uint8_t mode) {
+  halSleepMode = mode;
+}
+
+void sleep_enable () {}
+void sleep_disable () {}
+
+void sleep_cpu () {
+  // in power-down the clock stops and is corrected by the caller
+  if (halSleepMode != SLEEP_MODE_PWR_DOWN) {
+    halAdvance(1);
+  }
+}
+
+void sleep_mode () {
+  sleep_cpu();
+}
+
+void wdt_disable () {}
+void power_twi_disable () {}
+void power_usart0_disable () {}
+
+/*
+ * Memory layout
+ */
+uint8_t halRam[HAL_RAM_SIZE];
+char *__brkval = NULL;
+
+/*
+ * EEPROM
+ */
+uint8_t halEeprom[HAL_EEPROM_SIZE];
+EEPROMClass EEPROM;
+
+/*
+ * Temperature sensors
+ */
+float halTemperature = 21.5;
+float halHumidity = 55.0;
+
+bool DallasTemperature::getAddress (uint8_t *address, uint8_t index) {
+  memset(address, 0, 8);
+  address[0] = 0x28;
+  address[1] = index;
+  return true;
+}
+
+bool DallasTemperature::requestTemperaturesByAddress (const uint8_t *address) {
+  return true;
+}
+
+float DallasTemperature::getTempC (const uint8_t *address) {
+  return halTemperature;
+}
+
+int32_t DallasTemperature::getTemp (const uint8_t *address) {
+  return halTemperature * 128;
+}
+
+float DallasTemperature::getTempCByIndex (uint8_t index) {
+  return halTemperature;
+}
+
+float DHTStable::getTemperature () {
+  return halTemperature;
+}
+
+float DHTStable::getHumidity () {
+  return halHumidity;
+}
+
+/*
+ * Serial port, only used by the serial radio driver
+ */
+HardwareSerial Serial;
+
+/*
+ * Loopback radio
+ * Frames send by the node are stored in the tx queue and frames for the node
+ * are injected into the rx queue by the host side.
+ */
+HalRadioFrame halRadioRx[HAL_RADIO_QUEUE_LEN];
+uint8_t halRadioRxCount = 0;
+HalRadioFrame halRadioTx[HAL_RADIO_QUEUE_LEN];
+uint8_t halRadioTxCount = 0;
+bool halRadioChannelActive = false;
+unsigned long halRadioTxUntil = 0;
+
+/**
+ * Add a frame to a queue.
+ */
+bool halRadioPush (HalRadioFrame *queue, uint8_t *count, uint8_t from, uint8_t to, uint8_t id, uint8_t flags, const uint8_t *data, uint8_t len) {
+  if (*count >= HAL_RADIO_QUEUE_LEN || len > HAL_RADIO_MAX_LEN) {
+    return false;
+  }
+  HalRadioFrame *frame = &queue[*count];
+  frame->from = from;
+  frame->to = to;
+  frame->id = id;
+  frame->flags = flags;
+  frame->len = len;
+  memcpy(frame->data, data, len);
+  (*count)++;
+  return true;
+}
+
+/**
+ * Remove the first frame from a queue.
+ */
+void halRadioPop (HalRadioFrame *queue, uint8_t *count, HalRadioFrame *frame) {
+  if (frame) {
+    *frame = queue[0];
+  }
+  (*count)--;
+  memmove(&queue[0], &queue[1], *count * sizeof(HalRadioFrame));
+}
+
+/**
+ * Inject a frame to be received by the node.
+ */
+bool halRadioInject (uint8_t from, uint8_t to, uint8_t id, uint8_t flags, const uint8_t *data, uint8_t len) {
+  return halRadioPush(halRadioRx, &halRadioRxCount, from, to, id, flags, data, len);
+}
+
+/**
+ * Take the next frame send by the node.
+ */
+bool halRadioTake (HalRadioFrame *frame) {
+  if (halRadioTxCount == 0) {
+    return false;
+  }
+  halRadioPop(halRadioTx, &halRadioTxCount, frame);
+  return true;
+}
+
+bool RHDatagram::available () {
+  // drop frames for other nodes like the address filter of the driver
+  while (halRadioRxCount > 0
+    && halRadioRx[0].to != _thisAddress
+    && halRadioRx[0].to != RH_BROADCAST_ADDRESS) {
+    halRadioPop(halRadioRx, &halRadioRxCount, NULL);
+  }
+  _driver.setModeRx();
+  return halRadioRxCount > 0;
+}
+
+bool RHDatagram::sendto (uint8_t *buf, uint8_t len, uint8_t address) {
+  halRadioTxUntil = millis() + RH_AIRTIME(len);
+  return halRadioPush(halRadioTx, &halRadioTxCount, _thisAddress, address, _txId, _txFlags, buf, len);
+}
+
+bool RHDatagram::recvfrom (uint8_t *buf, uint8_t *len, uint8_t *from, uint8_t *to, uint8_t *id, uint8_t *flags) {
+  if (!available()) {
+    return false;
+  }
+
+  HalRadioFrame frame;
+  halRadioPop(halRadioRx, &halRadioRxCount, &frame);
+
+  if (buf && len) {
+    if (*len > frame.len) {
+      *len = frame.len;
+    }
+    memcpy(buf, frame.data, *len);
+  }
+  if (from) *from = frame.from;
+  if (to) *to = frame.to;
+  if (id) *id = frame.id;
+  if (flags) *flags = frame.flags;
+  return true;
+}
+
+/*
+ * Host program
+ */
+
+/**
+ * Run one pass of the loop and advance the clock if the loop didn't sleep.
+ */
+void halStep () {
+  unsigned long before = millis();
+  loop();
+  halAdcProcess();
+  if (millis() == before) {
+    halAdvance(1);
+  }
+}
+
+#ifdef HAL_NATIVE_LIB
+
+/**
+ * Start the node with the given own address, check interval and next hop to
+ * the server, as if it was configured before.
+ */
+void halNodeSetup (uint8_t ownAddress, uint16_t checkInterval, uint8_t routeVia) {
+  memset(halEeprom, 0xFF, sizeof(halEeprom));
+  loadDefaultSettings();
+  settings.ownAddress = ownAddress;
+  settings.checkInterval = checkInterval;
+  settings.routeVia = routeVia;
+  clearSettings();
+  saveSettings();
+  EEPROM.update(EEPROM_ADDR_VERSION, EEPROM_VERSION);
+
+  setup();
+}
+
+// entry points for the simulator
+HalNode halNode = {
+  halNodeSetup,
+  halStep,
+  millis,
+  halRadioTake,
+  halRadioInject,
+  &halRadioChannelActive,
+  RH_ROUTE_HEADER_LEN
+};
+
+#elif !defined(PIO_UNIT_TESTING)
+
+/**
+ * Print all frames send by the node and acknowledge them like a server would do.
+ */
+void halServe () {
+  HalRadioFrame frame;
+  while (halRadioTake(&frame)) {
+    printf("%10lu %02X -> %02X id %3u flags %02X:", millis(), frame.from, frame.to, frame.id, frame.flags);
+    for (uint8_t i = 0; i < frame.len; i++) {
+      printf(" %02X", frame.data[i]);
+    }
+    printf("\n");
+
+    if (!(frame.flags & RH_FLAGS_ACK) && frame.to != RH_BROADCAST_ADDRESS) {
+      uint8_t ack = '!';
+      halRadioInject(frame.to, frame.from, frame.id, RH_FLAGS_ACK, &ack, sizeof(ack));
+    }
+  }
+}
+
+/**
+ * Run the firmware for the given number of seconds (default 600) of virtual time.
+ */
+int main (int argc, char **argv) {
+  unsigned long runTime = (argc > 1) ? strtoul(argv[1], NULL, 10) * 1000 : 600000;
+
+  // unprogrammed eeprom
+  memset(halEeprom, 0xFF, sizeof(halEeprom));
+
+  setup();
+
+  while (millis() < runTime) {
+    halStep();
+    halServe();
+  }
+
+  return 0;
+}
+
+#endif
+
+#endif
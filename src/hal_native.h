@@ -0,0 +1,353 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Fakes of the hardware API for the native build on the host.
+ *
+ * Provides the used parts of the Arduino core, AVR libc and libraries with
+ * fake pins and adc inputs, a virtual clock, an in-memory eeprom and a
+ * loopback radio. The hal* functions and variables are used by the host
+ * side to drive the simulation.
+ */
+
+#ifndef __HAL_NATIVE_H__
+#define __HAL_NATIVE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Arduino core
+ */
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define SS 10
+
+#define HAL_PIN_COUNT 22
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+unsigned long millis ();
+unsigned long micros ();
+void delay (unsigned long ms);
+void delayMicroseconds (unsigned int us);
+
+void pinMode (uint8_t pin, uint8_t mode);
+void digitalWrite (uint8_t pin, uint8_t val);
+int digitalRead (uint8_t pin);
+
+long random (long howbig);
+long random (long howsmall, long howbig);
+void randomSeed (unsigned long seed);
+
+/*
+ * AVR registers and interrupts
+ */
+extern volatile uint8_t ADMUX;
+extern volatile uint8_t ADCSRA;
+extern volatile uint16_t ADC;
+extern volatile uint8_t DIDR0;
+extern volatile uint8_t ACSR;
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t WDTCSR;
+
+#define ADLAR 5
+#define REFS1 7
+#define REFS0 6
+#define ADEN  7
+#define ADSC  6
+#define ADIF  4
+#define ADIE  3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ACD   7
+#define WDRF  3
+#define WDIE  6
+#define WDCE  4
+#define WDE   3
+
+#define ISR(vector) void vector (void)
+#define ADC_vect halAdcVect
+#define WDT_vect halWdtVect
+void halAdcVect (void);
+void halWdtVect (void);
+
+void cli ();
+void sei ();
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (uint8_t halAtomic = 1; halAtomic; halAtomic = 0)
+
+/*
+ * Sleep, power and watchdog
+ */
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_ADC      1
+#define SLEEP_MODE_PWR_DOWN 2
+
+void set_sleep_mode (uint8_t mode);
+void sleep_enable ();
+void sleep_disable ();
+void sleep_cpu ();
+void sleep_mode ();
+void wdt_disable ();
+
+void power_twi_disable ();
+void power_usart0_disable ();
+
+/*
+ * Memory layout
+ * Fake SRAM of the ATmega328 with a fixed size of the static data and the
+ * used stack. The names are the ones of the linker script and avr-libc.
+ */
+#define HAL_RAM_SIZE   2048
+#define HAL_RAM_STATIC 1024  // size of the data and bss sections
+#define HAL_RAM_STACK  256   // size of the used stack
+#define HAL_FLASH_USED 24576 // size of the program in flash
+
+extern uint8_t halRam[HAL_RAM_SIZE];
+extern char *__brkval;
+
+#define RAMSTART        ((uintptr_t)&halRam[0])
+#define RAMEND          ((uintptr_t)&halRam[HAL_RAM_SIZE - 1])
+#define SP              ((uintptr_t)&halRam[HAL_RAM_SIZE - 1 - HAL_RAM_STACK])
+#define __data_start    halRam[0]
+#define __heap_start    halRam[HAL_RAM_STATIC]
+#define __data_load_end (*(char *)HAL_FLASH_USED)
+
+/*
+ * EEPROM
+ */
+#define HAL_EEPROM_SIZE 1024
+#define E2END (HAL_EEPROM_SIZE - 1)
+
+extern uint8_t halEeprom[HAL_EEPROM_SIZE];
+
+class EEPROMClass {
+public:
+  uint8_t read (int idx) { return halEeprom[idx]; }
+  void write (int idx, uint8_t val) { halEeprom[idx] = val; }
+  void update (int idx, uint8_t val) { halEeprom[idx] = val; }
+  uint16_t length () { return HAL_EEPROM_SIZE; }
+  template <typename T> T &get (int idx, T &t) {
+    memcpy(&t, &halEeprom[idx], sizeof(T));
+    return t;
+  }
+  template <typename T> const T &put (int idx, const T &t) {
+    memcpy(&halEeprom[idx], &t, sizeof(T));
+    return t;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+// CRC-16 (polynomial 0xA001) like in util/crc16.h
+inline uint16_t _crc16_update (uint16_t crc, uint8_t a) {
+  crc ^= a;
+  for (uint8_t i = 0; i < 8; i++) {
+    crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+  }
+  return crc;
+}
+
+/*
+ * PinChangeInterrupt
+ */
+#define digitalPinToPCINT(p) (p)
+
+void attachPCINT (uint8_t pcintNum, void (*userFunc)(void), uint8_t mode);
+
+/*
+ * Temperature sensors
+ */
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_RAW -7040
+#define DHTLIB_OK 0
+
+class OneWire {
+public:
+  OneWire (uint8_t pin) {}
+};
+
+class DallasTemperature {
+public:
+  DallasTemperature (OneWire *oneWire) {}
+  void begin () {}
+  bool setResolution (uint8_t resolution) { _resolution = resolution; return true; }
+  void setWaitForConversion (bool wait) {}
+  bool getAddress (uint8_t *address, uint8_t index);
+  bool requestTemperaturesByAddress (const uint8_t *address);
+  int16_t millisToWaitForConversion (uint8_t resolution) { return 750 / (1 << (12 - resolution)); }
+  float getTempC (const uint8_t *address);
+  int32_t getTemp (const uint8_t *address);
+  float getTempCByIndex (uint8_t index);
+private:
+  uint8_t _resolution;
+};
+
+class DHTStable {
+public:
+  int read11 (uint8_t pin) { return DHTLIB_OK; }
+  int read12 (uint8_t pin) { return DHTLIB_OK; }
+  int read22 (uint8_t pin) { return DHTLIB_OK; }
+  float getTemperature ();
+  float getHumidity ();
+};
+
+/*
+ * RadioHead
+ */
+#define RH_BROADCAST_ADDRESS 0xff
+#define RH_FLAGS_NONE 0x00
+#define RH_FLAGS_ACK  0x80
+
+#define HAL_RADIO_MAX_LEN   64
+#define HAL_RADIO_QUEUE_LEN 8
+
+// channel in use by another node, set by the host side
+extern bool halRadioChannelActive;
+// time until the last send frame is on the air
+extern unsigned long halRadioTxUntil;
+
+// frame on the loopback radio medium
+struct HalRadioFrame {
+  uint8_t from;
+  uint8_t to;
+  uint8_t id;
+  uint8_t flags;
+  uint8_t len;
+  uint8_t data[HAL_RADIO_MAX_LEN];
+};
+
+class RHGenericDriver {
+public:
+  typedef enum {
+    RHModeInitialising = 0,
+    RHModeSleep,
+    RHModeIdle,
+    RHModeTx,
+    RHModeRx,
+    RHModeCad
+  } RHMode;
+
+  RHMode mode () { return (millis() < halRadioTxUntil) ? RHModeTx : _mode; }
+  void setModeIdle () { _mode = RHModeIdle; }
+  void setModeRx () { _mode = RHModeRx; }
+  bool isChannelActive () { return halRadioChannelActive; }
+protected:
+  RHMode _mode = RHModeIdle;
+};
+
+#define RH_ASK_MAX_MESSAGE_LEN    60
+#define RH_RF69_MAX_MESSAGE_LEN   60
+#define RH_RF95_MAX_MESSAGE_LEN   251
+#define RH_SERIAL_MAX_MESSAGE_LEN 60
+
+class HardwareSerial {
+public:
+  void begin (unsigned long baud) {}
+};
+
+extern HardwareSerial Serial;
+
+class RH_ASK : public RHGenericDriver {
+public:
+  RH_ASK (uint16_t speed = 2000, uint8_t rxPin = 11, uint8_t txPin = 12, uint8_t pttPin = 10, bool pttInverted = false) {}
+};
+
+class RH_RF69 : public RHGenericDriver {
+public:
+  RH_RF69 (uint8_t slaveSelectPin = SS, uint8_t interruptPin = 2) {}
+  bool setFrequency (float centre, float afcPullInRange = 0.05) { return true; }
+  void setTxPower (int8_t power, bool ishighpowermodule = true) {}
+};
+
+class RH_RF95 : public RHGenericDriver {
+public:
+  RH_RF95 (uint8_t slaveSelectPin = SS, uint8_t interruptPin = 2) {}
+  bool setFrequency (float centre) { return true; }
+  void setTxPower (int8_t power, bool useRFO = false) {}
+};
+
+class RH_Serial : public RHGenericDriver {
+public:
+  RH_Serial (HardwareSerial &serial) {}
+};
+
+class RHDatagram {
+public:
+  RHDatagram (RHGenericDriver &driver, uint8_t thisAddress = 0) : _driver(driver), _thisAddress(thisAddress) {}
+  bool init () { return true; }
+  void setThisAddress (uint8_t thisAddress) { _thisAddress = thisAddress; }
+  void setHeaderId (uint8_t id) { _txId = id; }
+  void setHeaderFlags (uint8_t set, uint8_t clear = 0xFF) { _txFlags = (_txFlags & ~clear) | set; }
+  bool available ();
+  bool sendto (uint8_t *buf, uint8_t len, uint8_t address);
+  bool recvfrom (uint8_t *buf, uint8_t *len, uint8_t *from = NULL, uint8_t *to = NULL, uint8_t *id = NULL, uint8_t *flags = NULL);
+private:
+  RHGenericDriver &_driver;
+  uint8_t _thisAddress;
+  uint8_t _txId = 0;
+  uint8_t _txFlags = 0;
+};
+
+/*
+ * Simulation control for the host side
+ */
+extern uint16_t halAnalogValues[8];
+extern bool halAdcHold;
+extern float halTemperature;
+extern float halHumidity;
+
+void halAdvance (unsigned long ms);
+void halStep ();
+void halPressButton (uint8_t pin);
+bool halRadioInject (uint8_t from, uint8_t to, uint8_t id, uint8_t flags, const uint8_t *data, uint8_t len);
+bool halRadioTake (HalRadioFrame *frame);
+
+/*
+ * Node library for the multi-node simulator (see sim/sim.cpp)
+ * Built with HAL_NATIVE_LIB as shared library, each loaded copy is one node
+ * with its own clock, memory and radio queues.
+ */
+struct HalNode {
+  void (*setup) (uint8_t ownAddress, uint16_t checkInterval, uint8_t routeVia);
+  void (*step) ();
+  unsigned long (*millis) ();
+  bool (*take) (HalRadioFrame *frame);
+  bool (*inject) (uint8_t from, uint8_t to, uint8_t id, uint8_t flags, const uint8_t *data, uint8_t len);
+  bool *channelActive;
+  uint8_t routeHeaderLen; // length of the route header in front of each message
+};
+
+#ifdef HAL_NATIVE_LIB
+  extern "C" HalNode halNode;
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * History of the sensor values.
+ *
+ * After each check a sample with the current values is added to a ring
+ * buffer in SRAM or EEPROM. Each sample has a sequence number, so the server
+ * can download the history in chunks and resume after the last received
+ * sequence number.
+ *
+ * In EEPROM the slots are written in order, so the newest sample is the last
+ * one with a consecutive sequence number, found in one pass at startup.
+ */
+
+#include "history.h"
+
+#if HISTORY_ENABLED == 1
+
+#include "rh.h"
+
+#if HISTORY_EEPROM == 0
+  HistorySample historySamples[HISTORY_SLOTS];
+#endif
+
+// slot for the next sample
+uint8_t historyHead = 0;
+// number of samples in the history
+uint8_t historyCount = 0;
+// number of samples added since startup
+uint8_t historyRunCount = 0;
+// sequence number of the next sample
+uint16_t historyNextSeq = 0;
+
+/**
+ * Read a sample from a slot.
+ */
+void historyRead (uint8_t slot, HistorySample *sample) {
+  #if HISTORY_EEPROM == 1
+    EEPROM.get(EEPROM_ADDR_HISTORY + slot * sizeof(HistorySample), *sample);
+  #else
+    *sample = historySamples[slot];
+  #endif
+}
+
+/**
+ * Write a sample into a slot.
+ * In EEPROM only the changed bytes are written.
+ */
+void historyWrite (uint8_t slot, HistorySample *sample) {
+  #if HISTORY_EEPROM == 1
+    EEPROM.put(EEPROM_ADDR_HISTORY + slot * sizeof(HistorySample), *sample);
+  #else
+    historySamples[slot] = *sample;
+  #endif
+}
+
+/**
+ * Get the sequence number following the given one.
+ */
+uint16_t historySeqNext (uint16_t seq) {
+  return (seq + 1) % HISTORY_SEQ_MOD;
+}
+
+/**
+ * Get the distance from sequence number a to b.
+ */
+uint16_t historySeqDiff (uint16_t b, uint16_t a) {
+  return ((uint32_t)b + HISTORY_SEQ_MOD - a) % HISTORY_SEQ_MOD;
+}
+
+/**
+ * Init the history.
+ * Must be called once at startup time.
+ * @param clear If the history stored in EEPROM should be cleared.
+ */
+void historyInit (bool clear) {
+  historyHead = 0;
+  historyCount = 0;
+  historyRunCount = 0;
+  historyNextSeq = 0;
+
+  #if HISTORY_EEPROM == 1
+    HistorySample sample;
+
+    if (clear) {
+      // mark all slots as empty
+      memset(&sample, 0, sizeof(sample));
+      sample.seq = HISTORY_SEQ_EMPTY;
+      for (uint8_t slot = 0; slot < HISTORY_SLOTS; slot++) {
+        historyWrite(slot, &sample);
+      }
+      return;
+    }
+
+    // find the newest sample, which is the last one with a consecutive sequence number
+    historyRead(0, &sample);
+    if (sample.seq == HISTORY_SEQ_EMPTY) {
+      return;
+    }
+    uint16_t seq = sample.seq;
+    uint8_t slot = 1;
+    for (; slot < HISTORY_SLOTS; slot++) {
+      historyRead(slot, &sample);
+      if (sample.seq != historySeqNext(seq)) {
+        break;
+      }
+      seq = sample.seq;
+    }
+
+    // the ring is full if the slot after the newest is not empty
+    historyHead = slot % HISTORY_SLOTS;
+    historyCount = (slot < HISTORY_SLOTS && sample.seq == HISTORY_SEQ_EMPTY) ? slot : HISTORY_SLOTS;
+    historyNextSeq = historySeqNext(seq);
+  #endif
+}
+
+/**
+ * Add a sample with the current values to the history.
+ */
+void historyAdd () {
+  HistorySample sample;
+  memset(&sample, 0, sizeof(sample));
+
+  sample.seq = historyNextSeq;
+  sample.time = millis() / 60000;
+
+  // pack the 10 bit adc values
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    uint16_t bits = ((settings.channelEnabled & CHANNEL_BIT(chan)) ? (adcValues[chan] & 0x03FF) : 0) << ((chan * 10) % 8);
+    sample.adc[(chan * 10) / 8] |= bits & 0xFF;
+    sample.adc[(chan * 10) / 8 + 1] |= bits >> 8;
+  }
+
+  #if TEMP_SENSOR_TYPE != 0
+    sample.temperature = (temperature == TEMP_INVALID) ? HISTORY_NO_TEMP : temperature / 10;
+  #else
+    sample.temperature = HISTORY_NO_TEMP;
+  #endif
+  #if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
+    sample.humidity = (humidity < 0) ? HISTORY_NO_VALUE : (humidity + 50) / 100;
+  #else
+    sample.humidity = HISTORY_NO_VALUE;
+  #endif
+  #if BAT_ENABLED == 1
+    sample.battery = batteryPercent();
+  #else
+    sample.battery = HISTORY_NO_VALUE;
+  #endif
+
+  historyWrite(historyHead, &sample);
+  historyHead = (historyHead + 1) % HISTORY_SLOTS;
+  if (historyCount < HISTORY_SLOTS) {
+    historyCount++;
+  }
+  if (historyRunCount < HISTORY_SLOTS) {
+    historyRunCount++;
+  }
+  historyNextSeq = historySeqNext(historyNextSeq);
+}
+
+/**
+ * Send the history starting at the given sequence number in chunks.
+ * If the sequence number is not in the history anymore or ahead of the newest
+ * sample, the oldest sample is used. A sequence number ahead is left from
+ * before a restart with the history in SRAM or a cleared history, so the
+ * samples added since then are send instead of skipped. The chunks are queued as long as there is space in the transmit queue.
+ * @param seq       Sequence number of the first sample to send.
+ * @param maxChunks Max number of chunks to send, 0 for no limit.
+ * @param sendTo    Address to send the chunks to.
+ */
+void historySend (uint16_t seq, uint8_t maxChunks, uint8_t sendTo) {
+  uint16_t oldestSeq = historySeqDiff(historyNextSeq, historyCount);
+
+  // offset of the first requested sample from the oldest one
+  uint16_t offset = historySeqDiff(seq, oldestSeq);
+  if (offset > historyCount) {
+    // older than the oldest sample or ahead of the newest one
+    offset = 0;
+  }
+
+  uint16_t now = millis() / 60000;
+  uint8_t chunks = 0;
+  do {
+    uint16_t chunkSeq = historySeqDiff(historyNextSeq, historyCount - offset);
+    uint8_t count = 0;
+    uint8_t len = 4;
+
+    while (count < HISTORY_CHUNK_SAMPLES && offset < historyCount) {
+      HistorySample sample;
+      historyRead((historyHead + HISTORY_SLOTS - historyCount + offset) % HISTORY_SLOTS, &sample);
+
+      // the age is only known for samples added since startup
+      uint16_t age = (historyCount - offset <= historyRunCount) ? now - sample.time : HISTORY_NO_AGE;
+      memcpy(&rhBufTx[len], &age, 2);
+      memcpy(&rhBufTx[len + 2], sample.adc, HISTORY_ADC_LEN);
+      memcpy(&rhBufTx[len + 2 + HISTORY_ADC_LEN], &sample.temperature, 2);
+      rhBufTx[len + 4 + HISTORY_ADC_LEN] = sample.humidity;
+      rhBufTx[len + 5 + HISTORY_ADC_LEN] = sample.battery;
+
+      len += HISTORY_SAMPLE_LEN;
+      count++;
+      offset++;
+    }
+
+    memcpy(&rhBufTx[1], &chunkSeq, 2);
+    rhBufTx[3] = count | ((offset < historyCount) ? HISTORY_CHUNK_MORE : 0x00);
+    rhSend(RH_MSG_HISTORY, len, sendTo);
+    chunks++;
+  } while (offset < historyCount && (maxChunks == 0 || chunks < maxChunks) && rhTxQueueUsed() < RH_TX_QUEUE_LEN);
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include "globals.h"
+
+#if HISTORY_LEN > 0 || HISTORY_EEPROM == 1
+  #define HISTORY_ENABLED 1
+#else
+  #define HISTORY_ENABLED 0
+#endif
+
+// sequence numbers run from 0 to 0xFFFE, 0xFFFF marks an empty slot
+#define HISTORY_SEQ_MOD   0xFFFF
+#define HISTORY_SEQ_EMPTY 0xFFFF
+
+// markers for values which are not available
+#define HISTORY_NO_TEMP  ((int16_t)0x8000)
+#define HISTORY_NO_VALUE 0xFF
+#define HISTORY_NO_AGE   0xFFFF
+
+// size of the packed 10 bit adc values of all channels
+#define HISTORY_ADC_LEN ((CHANNEL_COUNT * 10 + 7) / 8)
+
+// size of a sample in a history message
+// [0..1] age in minutes, [2..] 10 bit adc values, then int16 temperature in tenth degree, uint8 humidity, uint8 battery
+#define HISTORY_SAMPLE_LEN (6 + HISTORY_ADC_LEN)
+// number of samples in one history message, as many as fit into the buffer
+// [1..2] sequence number of the first sample, [3] bits 0-6 number of samples, bit 7 more samples available
+#define HISTORY_CHUNK_SAMPLES ((RH_BUF_TX_LEN - 4) / HISTORY_SAMPLE_LEN)
+#define HISTORY_CHUNK_MORE    0x80
+
+// stored sample of the history
+struct HistorySample {
+  uint16_t seq;        // sequence number
+  uint16_t time;       // minutes since startup
+  uint8_t adc[HISTORY_ADC_LEN]; // packed 10 bit adc values
+  int16_t temperature; // temperature in tenth degree
+  uint8_t humidity;    // humidity in percent
+  uint8_t battery;     // battery in percent
+};
+
+#if HISTORY_EEPROM == 1
+  #define HISTORY_SLOTS ((E2END + 1 - EEPROM_ADDR_HISTORY) / sizeof(HistorySample))
+#else
+  #define HISTORY_SLOTS HISTORY_LEN
+#endif
+
+void historyInit (bool clear);
+void historyAdd ();
+void historySend (uint16_t seq, uint8_t maxChunks, uint8_t sendTo);
+
+#endif
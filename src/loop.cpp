@@ -9,164 +9,471 @@
 #include "loop.h"
 
 #include "actions.h"
+#include "adc.h"
+#include "history.h"
+#include "powersave.h"
+#include "sampling.h"
+#include "scheduler.h"
 #include "settings.h"
+#include "telemetry.h"
+#include "valves.h"
 #include "rh.h"
 
-bool adcOn = false;
+// number of loop passes
+uint32_t loopPassCount = 0;
+// longest pass time in microseconds and the site which caused it
+uint32_t loopPassMax = 0;
+uint8_t loopStallSite = LOOP_SITE_NONE;
+// number of passes in each bucket of the pass time histogram
+uint16_t loopHistogram[LOOP_HISTOGRAM_LEN];
+// sum of the pass times, split into milliseconds and the remaining microseconds
+uint32_t loopBusyMillis = 0;
+uint16_t loopBusyMicros = 0;
 
-void loop () {
+// time of the last adc read start
+unsigned long adcReadTime = 0;
+// time when the sensors were turned on and the sum of the sensor on times in milliseconds
+unsigned long sensorsOnSince = 0;
+uint32_t sensorsOnTime = 0;
+
+// channels waiting for the sensors to settle and if the adc is reading them
+ChannelMask sensorsSettleMask = 0;
+bool sensorsSettling = false;
+// if the next reading is the first one after turning on the sensors
+bool sensorsSettleFirst = false;
+// last reading of each channel while waiting to settle
+uint16_t sensorsSettleLast[CHANNEL_COUNT];
+// time in milliseconds the sensors needed to settle on the last check
+uint16_t sensorsSettleTime[CHANNEL_COUNT];
+// channels which settled within the warmup time on the last check
+ChannelMask sensorsSettled = 0;
+
+// temperature sensor code only if TEMP_SENSOR_TYPE is not 0
+#if TEMP_SENSOR_TYPE != 0
+/**
+ * Handle the result of a temperature sensor read.
+ * Checks the temperature switch and sends the data.
+ * @param sensorReadOk If the sensor read was successful.
+ */
+void handleTempSensorData (bool sensorReadOk) {
+  if (sensorReadOk) {
+    // check temperature switch
+    if (tempSwitchTriggerValueLow != 0 && tempSwitchTriggerValueHigh != 0) {
+      // automatic switching enabled
+      if (!tempSwitchOn && (
+        (temperature >= tempSwitchTriggerValueHigh && !settings.tempSwitchInverted)
+        || (temperature <= tempSwitchTriggerValueLow && settings.tempSwitchInverted)
+      )) {
+        // turn on the temperature switch
+        digitalWrite(TEMP_SWITCH_PIN, HIGH);
+        tempSwitchOn = true;
+      } else if (tempSwitchOn && (
+        (temperature <= tempSwitchTriggerValueLow && !settings.tempSwitchInverted)
+        || (temperature >= tempSwitchTriggerValueHigh && settings.tempSwitchInverted)
+      )) {
+        // turn off the temperature switch
+        digitalWrite(TEMP_SWITCH_PIN, LOW);
+        tempSwitchOn = false;
+      }
+    }
+    // send data
+    telemetryPush(TELEMETRY_TEMP);
+  } else {
+    // sensor read error
+    blinkCode(BLINK_CODE_TEMP_SENSOR_ERROR);
+  }
+}
+
+/**
+ * Task to read from the temperature sensor.
+ * For DS18x20 sensors this only starts the conversion and the result is
+ * collected later by the temperature sensor read task.
+ */
+void taskTempSensor (uint8_t task, unsigned long now) {
+  // read from the sensor using the correct method for the sensor type
+
+  #if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
+    // DHT sensor
+    #if TEMP_SENSOR_TYPE == 11
+      int dhtResult = dhtSensor.read11(TEMP_SENSOR_PIN);
+    #elif TEMP_SENSOR_TYPE == 12
+      int dhtResult = dhtSensor.read12(TEMP_SENSOR_PIN);
+    #elif TEMP_SENSOR_TYPE == 22
+      int dhtResult = dhtSensor.read22(TEMP_SENSOR_PIN);
+    #endif
+
+    // get the values in hundredth, the library only provides them as float
+    int32_t dhtTemperature = dhtSensor.getTemperature() * 100;
+    int32_t dhtHumidity = dhtSensor.getHumidity() * 100;
+
+    // check the result and also if the values are plausible
+    if (dhtResult == DHTLIB_OK
+      && dhtHumidity >= 0 && dhtHumidity <= 10000
+      && dhtTemperature >= -5000 && dhtTemperature <= 10000) {
+      // sensor read ok
+      temperature = dhtTemperature;
+      humidity = dhtHumidity;
+      handleTempSensorData(true);
+    } else {
+      temperature = TEMP_INVALID;
+      humidity = TEMP_INVALID;
+      handleTempSensorData(false);
+    }
+
+  #elif TEMP_SENSOR_TYPE == 1820
+    // DS18x20 sensor
+    // search the sensor again if it was not found before
+    if (!ds1820AddressValid) {
+      ds1820AddressValid = ds1820.getAddress(ds1820Address, 0);
+    }
+
+    // start the conversion and collect the result when it's done
+    if (ds1820AddressValid && ds1820.requestTemperaturesByAddress(ds1820Address)) {
+      schedulerSet(TASK_TEMP_SENSOR_READ, now + ds1820.millisToWaitForConversion(DS1820_RESOLUTION));
+    } else {
+      ds1820AddressValid = false;
+      temperature = TEMP_INVALID;
+      handleTempSensorData(false);
+    }
+
+  #else
+    #error TEMP_SENSOR_TYPE must be 11, 12, 22, 1820 or 0!
+  #endif
+
+  // calc next dht read time
+  schedulerSet(TASK_TEMP_SENSOR, now + ((uint32_t)settings.tempSensorInterval * 1000) + random(0, SCHEDULE_JITTER_CYCLE));
+}
+
+#if TEMP_SENSOR_TYPE == 1820
+/**
+ * Task to collect the result of a DS18x20 conversion.
+ */
+void taskTempSensorRead (uint8_t task, unsigned long now) {
+  // read the scratchpad of the cached sensor address, raw value in 1/128 degree
+  int32_t raw = ds1820.getTemp(ds1820Address);
+
+  if (raw != DEVICE_DISCONNECTED_RAW) {
+    temperature = raw * 25 / 32;
+    handleTempSensorData(true);
+  } else {
+    // search the sensor again on the next read
+    ds1820AddressValid = false;
+    temperature = TEMP_INVALID;
+    handleTempSensorData(false);
+  }
+}
+#endif
+#endif
+
+/**
+ * Task to turn on the adc and sensors the warmup time before reading the adc values.
+ * This is to give the sensors and the adc some time to reach a stable level.
+ * If a settle tolerance is set, the sensors are read until they are settled
+ * and the adc values are read early.
+ */
+void taskSensorsOn (uint8_t task, unsigned long now) {
+  // enable the adc
+  adcEnable();
+
+  // enable the sensors
+  digitalWrite(SENSORS_ACTIVE_PIN, HIGH);
+  sensorsOnSince = now;
+
+  sensorsSettleMask = 0;
+  sensorsSettled = 0;
+  sensorsSettleFirst = true;
+  if (settings.settleTolerance > 0 && !pauseAutomatic) {
+    sensorsSettleMask = settings.channelEnabled;
+    schedulerSet(TASK_SENSORS_SETTLE, now + SENSORS_SETTLE_INTERVAL);
+  }
+}
+
+/**
+ * Task to read the sensors which are not settled yet.
+ * The values are handled by handleSettleValues() when all channels are read.
+ */
+void taskSensorsSettle (uint8_t task, unsigned long now) {
+  if (adcBusy()) {
+    schedulerSet(TASK_SENSORS_SETTLE, now + SENSORS_SETTLE_INTERVAL);
+    return;
+  }
+  sensorsSettling = true;
+  adcStart(sensorsSettleMask, 1);
+}
+
+/**
+ * Handle the adc values read while waiting for the sensors to settle.
+ * A channel is settled if two readings differ by the settle tolerance or
+ * less. If all channels are settled, the adc values are read right away.
+ */
+void handleSettleValues () {
   unsigned long now = millis();
+  sensorsSettling = false;
 
-  // temperature sensor code only if TEMP_SENSOR_TYPE is not 0
-  #if TEMP_SENSOR_TYPE != 0
-    // check if we need to read from the temperature sensor
-    if (checkTime(now, tempSensorNextReadTime)) {
-      // read from the sensor using the correct method for the sensor type
-
-      bool sensorReadOk = false;
-
-      #if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
-        // DHT sensor
-        #if TEMP_SENSOR_TYPE == 11
-          int dhtResult = dhtSensor.read11(TEMP_SENSOR_PIN);
-        #elif TEMP_SENSOR_TYPE == 12
-          int dhtResult = dhtSensor.read12(TEMP_SENSOR_PIN);
-        #elif TEMP_SENSOR_TYPE == 22
-          int dhtResult = dhtSensor.read22(TEMP_SENSOR_PIN);
-        #endif
-
-        // get the values
-        temperature = dhtSensor.getTemperature();
-        humidity = dhtSensor.getHumidity();
-
-        // check the result and also if the values are plausible
-        if (dhtResult == DHTLIB_OK
-          && humidity >= 0 && humidity <= 100
-          && temperature >= -50 && temperature <= 100) {
-          // sensor read ok
-          sensorReadOk = true;
-        } else {
-          temperature = -99;
-          humidity = -99;
-        }
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    if (!(sensorsSettleMask & CHANNEL_BIT(chan))) continue;
 
-      #elif TEMP_SENSOR_TYPE == 1820
-        // DS18x20 sensor
-        ds1820.requestTemperatures();
-        temperature = ds1820.getTempCByIndex(0);
+    if (!sensorsSettleFirst && abs((int16_t)(adcValues[chan] - sensorsSettleLast[chan])) <= settings.settleTolerance) {
+      sensorsSettleTime[chan] = now - sensorsOnSince;
+      sensorsSettled |= CHANNEL_BIT(chan);
+      sensorsSettleMask &= ~CHANNEL_BIT(chan);
+    }
+    sensorsSettleLast[chan] = adcValues[chan];
+  }
+  sensorsSettleFirst = false;
 
-        if (temperature != DEVICE_DISCONNECTED_C) {
-          sensorReadOk = true;
-        } else {
-          temperature = -99;
-        }
+  if (sensorsSettleMask == 0) {
+    schedulerSet(TASK_ADC_READ, now);
+  } else {
+    schedulerSet(TASK_SENSORS_SETTLE, now + SENSORS_SETTLE_INTERVAL);
+  }
+}
 
-      #else
-        #error TEMP_SENSOR_TYPE must be 11, 12, 22, 1820 or 0!
-      #endif
-
-      if (sensorReadOk) {
-        // check temperature switch
-        if (tempSwitchTriggerValueLow != 0.0 && tempSwitchTriggerValueHigh != 0.0) {
-          // automatic switching enabled
-          if (!tempSwitchOn && (
-            (temperature >= tempSwitchTriggerValueHigh && !settings.tempSwitchInverted)
-            || (temperature <= tempSwitchTriggerValueLow && settings.tempSwitchInverted)
-          )) {
-            // turn on the temperature switch
-            digitalWrite(TEMP_SWITCH_PIN, HIGH);
-            tempSwitchOn = true;
-          } else if (tempSwitchOn && (
-            (temperature <= tempSwitchTriggerValueLow && !settings.tempSwitchInverted)
-            || (temperature >= tempSwitchTriggerValueHigh && settings.tempSwitchInverted)
-          )) {
-            // turn off the temperature switch
-            digitalWrite(TEMP_SWITCH_PIN, LOW);
-            tempSwitchOn = false;
-          }
-        }
-        // send data
-        rhSendData(RH_MSG_TEMP_SENSOR_DATA);
-      } else {
-        // sensor read error
-        blinkCode(BLINK_CODE_TEMP_SENSOR_ERROR);
-      }
+/**
+ * Task to start reading the adc values in the background.
+ * The values are handled by handleAdcValues() when all channels are read.
+ */
+void taskAdcRead (uint8_t task, unsigned long now) {
+  uint16_t channelMask = 0;
 
-      // calc next dht read time
-      tempSensorNextReadTime = now + ((uint32_t)settings.tempSensorInterval * 1000);
+  // wait for a running settle reading, restarting the sequence would mix up the channels
+  if (adcBusy()) {
+    schedulerSet(TASK_ADC_READ, now + SENSORS_READ_RETRY);
+    return;
+  }
+
+  // the sensors which are not settled yet reached the warmup time
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    if (sensorsSettleMask & CHANNEL_BIT(chan)) {
+      sensorsSettleTime[chan] = now - sensorsOnSince;
     }
+  }
+  sensorsSettleMask = 0;
+  sensorsSettling = false;
+  schedulerCancel(TASK_SENSORS_SETTLE);
+
+  // only read sensors if not pause
+  if (!pauseAutomatic) {
+    channelMask = settings.channelEnabled;
+  }
+
+  // read battery voltage
+  #if BAT_ENABLED == 1
+    channelMask |= (1 << ADC_SEQ_BATTERY);
   #endif
 
-  // check if we need to turn on the adc and sensors 1 second before reading the adc values
-  // this is to give the sensors and the adc some time to reach a stable level
-  if (adcOn == false && checkTime(now, (adcNextReadTime - 1000))) {
-      // enable the adc
-      ADCSRA |= (1<<ADEN);
-
-      // enable the sensors
-      digitalWrite(SENSORS_ACTIVE_PIN, HIGH);
-
-      // set marker that the adc is on
-      adcOn = true;
-  }
-
-  // check if we need to read the adc values
-  if (checkTime(now, adcNextReadTime)) {
-    // only read sensors if not pause
-    if (!pauseAutomatic) {
-      // read adc values and check if we need to turn on some channels
-      for (uint8_t chan = 0; chan < 4; chan++) {
-        if (settings.channelEnabled[chan]) {
-          // read the adc value of the channel
-          adcValues[chan] = analogRead(sensorAdcPins[chan]);
-          // check trigger value
-          if (adcValues[chan] >= settings.adcTriggerValue[chan]) {
-            // set marker to turn the channel on
-            channelTurnOn[chan] = true;
-          }
+  adcStart(channelMask, constrain(settings.adcOversampling, 1, ADC_OVERSAMPLING_MAX));
+
+  // calc next adc read time
+  adcReadTime = now;
+  scheduleAdcRead(now + ((uint32_t)samplingCheckInterval() * 1000) + random(0, SCHEDULE_JITTER_CYCLE));
+}
+
+/**
+ * Handle the adc values after all channels are read.
+ */
+void handleAdcValues () {
+  // only check sensors if not pause
+  if (!pauseAutomatic) {
+    // filter the adc values and check if we need to turn on some channels
+    for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+      if (settings.channelEnabled & CHANNEL_BIT(chan)) {
+        adcValues[chan] = samplingFilter(chan, adcValues[chan]);
+        // check trigger value
+        if (adcValues[chan] >= settings.adcTriggerValue[chan]) {
+          // set marker to turn the channel on
+          channelMaskSet(channelTurnOn, chan);
         }
       }
-      // send RadioHead message (send adc check is done later...)
-      rhSendData(RH_MSG_SENSOR_VALUES);
     }
+  }
 
-    // disable the sensors
-    digitalWrite(SENSORS_ACTIVE_PIN, LOW);
+  // disable the sensors
+  digitalWrite(SENSORS_ACTIVE_PIN, LOW);
+  sensorsOnTime += millis() - sensorsOnSince;
 
-    // read battery voltage
-    #if BAT_ENABLED == 1
-      batteryRaw = analogRead(BATTERY_ADC);
-      rhSendData(RH_MSG_BATTERY);
-    #endif
+  // reschedule the next adc read if the adaptive check interval changed
+  if (samplingAdapt(millis())) {
+    scheduleAdcRead(adcReadTime + ((uint32_t)samplingCheckInterval() * 1000) + random(0, SCHEDULE_JITTER_CYCLE));
+  }
+
+  // add the values to the history
+  #if HISTORY_ENABLED == 1
+    historyAdd();
+  #endif
+
+  // send the sensor values (send adc check is done later...) and battery voltage
+  telemetryPush(pauseAutomatic ? TELEMETRY_BATTERY : TELEMETRY_SENSORS | TELEMETRY_BATTERY);
+
+  // disable the adc
+  adcDisable();
+}
+
+/**
+ * Task to turn off the valve of a channel after the watering time.
+ */
+void taskValveOff (uint8_t task, unsigned long now) {
+  turnValveOff(task - TASK_VALVE_OFF_0);
+}
+
+/**
+ * Task to receive RadioHead messages.
+ */
+void taskRhPoll (uint8_t task, unsigned long now) {
+  rhRecv();
+
+  #if POWERSAVE_MODE == 2
+    // in power-down mode the receiver is only active for some time after each send
+    if (checkTime(now, rhListenUntil)) {
+      rhStopListening();
+      return;
+    }
+  #endif
+
+  schedulerSet(TASK_RH_POLL, now + RH_POLL_INTERVAL);
+}
+
+/**
+ * Register all scheduled tasks.
+ * Must be called once at startup time before scheduling any task.
+ */
+void initTasks () {
+  #if TEMP_SENSOR_TYPE != 0
+    schedulerAdd(TASK_TEMP_SENSOR, taskTempSensor);
+  #endif
+  #if TEMP_SENSOR_TYPE == 1820
+    schedulerAdd(TASK_TEMP_SENSOR_READ, taskTempSensorRead);
+  #endif
+  schedulerAdd(TASK_SENSORS_ON, taskSensorsOn);
+  schedulerAdd(TASK_ADC_READ, taskAdcRead);
+  schedulerAdd(TASK_RH_POLL, taskRhPoll);
+  schedulerAdd(TASK_LED, taskLed);
+  schedulerAdd(TASK_RH_SEND, taskRhSend);
+  schedulerAdd(TASK_HEARTBEAT, taskHeartbeat);
+  schedulerAdd(TASK_VALVE_QUEUE, taskValveQueue);
+  schedulerAdd(TASK_SENSORS_SETTLE, taskSensorsSettle);
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    schedulerAdd(TASK_VALVE_OFF_0 + chan, taskValveOff);
+  }
+}
 
-    // disable the adc
-    ADCSRA &= ~(1<<ADEN);
+/**
+ * Schedule the next adc read at the given time.
+ * The sensors will be turned on the warmup time before.
+ */
+void scheduleAdcRead (unsigned long time) {
+  schedulerSet(TASK_SENSORS_ON, time - min(settings.sensorsWarmup, SENSORS_WARMUP_MAX));
+  schedulerSet(TASK_ADC_READ, time);
+}
+
+/**
+ * Add the time of a loop pass to the statistics.
+ * @param passTime The time of the pass in microseconds.
+ * @param site     The site which took the longest time in this pass.
+ */
+void loopStatsAdd (uint32_t passTime, uint8_t site) {
+  loopPassCount++;
 
-    // set marker that the adc is off
-    adcOn = false;
+  loopBusyMicros += passTime % 1000;
+  loopBusyMillis += passTime / 1000 + loopBusyMicros / 1000;
+  loopBusyMicros %= 1000;
 
-    // calc next adc read time
-    adcNextReadTime = now + ((uint32_t)settings.checkInterval * 1000);
+  if (passTime > loopPassMax) {
+    loopPassMax = passTime;
+    loopStallSite = site;
   }
 
-  for (uint8_t chan = 0; chan < 4; chan++) {
-    if (settings.channelEnabled[chan]) {
-      // check turn off
-      if (channelOn[chan] == true && checkTime(now, channelTurnOffTime[chan])) {
-        turnValveOff(chan);
+  // get the histogram bucket
+  uint8_t bucket = 0;
+  for (passTime >>= 8; passTime > 0 && bucket < LOOP_HISTOGRAM_LEN - 1; passTime >>= 2) {
+    bucket++;
+  }
+  if (loopHistogram[bucket] < 0xFFFF) {
+    loopHistogram[bucket]++;
+  }
+}
+
+/**
+ * Get the average time of a loop pass in microseconds.
+ */
+uint16_t loopPassAverage () {
+  if (loopPassCount == 0) {
+    return 0;
+  }
+  uint32_t avg;
+  if (loopBusyMillis < 0xFFFFFFFF / 1000) {
+    avg = (loopBusyMillis * 1000 + loopBusyMicros) / loopPassCount;
+  } else if (loopPassCount >= 1000) {
+    // the busy time in microseconds doesn't fit anymore
+    avg = loopBusyMillis / (loopPassCount / 1000);
+  } else {
+    return 0xFFFF;
+  }
+  return (avg > 0xFFFF) ? 0xFFFF : avg;
+}
+
+void loop () {
+  unsigned long now = millis();
+  unsigned long passStart = micros();
+
+  // handle channels to turn on or off requested by buttons or RadioHead messages
+  // channels to turn on are added to the queue and opened by the queue task
+  if (channelTurnOn || channelTurnOff) {
+    for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+      ChannelMask bit = CHANNEL_BIT(chan);
+      if (channelTurnOff & bit) {
+        // reset the turn off indicator
+        channelMaskClear(channelTurnOff, chan);
+        if (channelOn & bit) {
+          schedulerCancel(TASK_VALVE_OFF_0 + chan);
+          turnValveOff(chan);
+        } else {
+          valveQueueRemove(chan);
+        }
       }
       // check turn on
-      else if (channelOn[chan] == false && channelTurnOn[chan] == true) {
-        if (turnValveOn(chan)) {
-          // calc the turn off time
-          channelTurnOffTime[chan] = now + ((uint32_t)settings.wateringTime[chan] * 1000);
-          // reset the turn on indicator
-          channelTurnOn[chan] = false;
+      else if (channelTurnOn & bit) {
+        // reset the turn on indicator
+        channelMaskClear(channelTurnOn, chan);
+        if ((settings.channelEnabled & bit) && !(channelOn & bit)) {
+          valveQueueAdd(chan);
         }
       }
     }
   }
 
-  // receive RadioHead messages
-  rhRecv();
+  // the site with the longest time in this pass
+  unsigned long siteStart = micros();
+  unsigned long siteTime = siteStart - passStart;
+  uint8_t site = LOOP_SITE_CHANNELS;
+
+  // handle the adc values when the adc sequence is done
+  if (adcDone) {
+    adcDone = false;
+    if (sensorsSettling) {
+      handleSettleValues();
+    } else {
+      handleAdcValues();
+    }
+  }
+
+  unsigned long t = micros();
+  if (t - siteStart > siteTime) {
+    siteTime = t - siteStart;
+    site = LOOP_SITE_ADC_VALUES;
+  }
+  siteStart = t;
+
+  // run all due tasks
+  uint8_t task = schedulerRun(now);
+
+  t = micros();
+  if (task != SCHEDULER_END && t - siteStart > siteTime) {
+    site = task;
+  }
+
+  loopStatsAdd(t - passStart, site);
+
+  // sleep until the next task is due or an interrupt occurs
+  powersaveSleep(schedulerIdleTime(millis()));
 }
@@ -8,6 +8,30 @@
 
 #include "globals.h"
 
+// sites in a loop pass which may cause a stall
+// the scheduled tasks are identified by their task ids
+#define LOOP_SITE_CHANNELS   0xF0 // turning the valves on and off
+#define LOOP_SITE_ADC_VALUES 0xF1 // handling the adc values
+#define LOOP_SITE_NONE       0xFF
+
+// buckets of the pass time histogram
+// bucket 0 counts passes below 256us, each further bucket covers 4 times the
+// range of the one before (256us, 1ms, 4ms, 16ms, 65ms, 262ms, 1s) and the last
+// bucket counts all longer passes
+#define LOOP_HISTOGRAM_LEN 8
+
+// loop pass statistics
+extern uint32_t loopPassCount;
+extern uint32_t loopPassMax;
+extern uint8_t loopStallSite;
+extern uint16_t loopHistogram[LOOP_HISTOGRAM_LEN];
+extern uint32_t sensorsOnTime;
+extern uint16_t sensorsSettleTime[CHANNEL_COUNT];
+extern ChannelMask sensorsSettled;
+
+void initTasks ();
+void scheduleAdcRead (unsigned long time);
 void loop ();
+uint16_t loopPassAverage ();
 
 #endif
@@ -0,0 +1,57 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Statistics of the RAM and flash usage.
+ *
+ * The SRAM is used from the bottom by the static data and the heap and from
+ * the top by the stack. The free memory between them is painted with a
+ * pattern at startup, so the lowest overwritten byte shows how deep the
+ * stack has grown.
+ */
+
+#include "memory.h"
+
+/**
+ * Get the end of the heap, which is the start of the free memory.
+ */
+uint8_t *memoryHeapEnd () {
+  return (__brkval != NULL) ? (uint8_t *)__brkval : (uint8_t *)&__heap_start;
+}
+
+/**
+ * Paint the free memory below the current stack.
+ * Must be called once at startup time.
+ * The stack pointer points to the next free byte, so this one is painted too.
+ */
+void memoryPaint () {
+  uint8_t *p = memoryHeapEnd();
+  uint8_t *stack = (uint8_t *)SP;
+  while (p <= stack) {
+    *p++ = MEMORY_PAINT;
+  }
+}
+
+/**
+ * Get the current memory usage.
+ */
+void memoryGetStats (MemoryStats *stats) {
+  uint8_t *heapEnd = memoryHeapEnd();
+  uint8_t *stack = (uint8_t *)SP;
+
+  // find the lowest byte which is not painted anymore
+  uint8_t *highWater = heapEnd;
+  while (highWater <= stack && *highWater == MEMORY_PAINT) {
+    highWater++;
+  }
+
+  stats->ramSize = RAMEND - RAMSTART + 1;
+  stats->staticRam = (uintptr_t)&__heap_start - (uintptr_t)&__data_start;
+  stats->heapUsed = (uintptr_t)heapEnd - (uintptr_t)&__heap_start;
+  stats->stackUsed = RAMEND - (uintptr_t)stack;
+  stats->stackMax = RAMEND - (uintptr_t)highWater + 1;
+  stats->free = stack - heapEnd + 1;
+  stats->minFree = highWater - heapEnd;
+  stats->flashUsed = (uintptr_t)&__data_load_end;
+}
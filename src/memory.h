@@ -0,0 +1,29 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include "globals.h"
+
+// pattern painted into the free memory to find the max stack usage
+#define MEMORY_PAINT 0xC5
+
+// memory usage in bytes
+struct MemoryStats {
+  uint16_t ramSize;   // size of the SRAM
+  uint16_t staticRam; // data and bss
+  uint16_t heapUsed;  // memory allocated by malloc
+  uint16_t stackUsed; // current stack usage
+  uint16_t stackMax;  // max stack usage since startup
+  uint16_t free;      // current free memory between heap and stack
+  uint16_t minFree;   // min free memory since startup
+  uint16_t flashUsed; // program and initial data in flash
+};
+
+void memoryPaint ();
+void memoryGetStats (MemoryStats *stats);
+
+#endif
@@ -8,6 +8,8 @@
 
 #include "pcint.h"
 
+#include "valves.h"
+
 void handlePcintButton0 (void) {
   handlePcintButton(0);
 }
@@ -24,13 +26,46 @@ void handlePcintButton3 (void) {
   handlePcintButton(3);
 }
 
+void handlePcintButton4 (void) {
+  handlePcintButton(4);
+}
+
+void handlePcintButton5 (void) {
+  handlePcintButton(5);
+}
+
+void handlePcintButton6 (void) {
+  handlePcintButton(6);
+}
+
+void handlePcintButton7 (void) {
+  handlePcintButton(7);
+}
+
+/**
+ * Get the handler function for the button of a channel.
+ */
+PcintHandler pcintButtonHandler (uint8_t chan) {
+  switch (chan) {
+    case 0: return handlePcintButton0;
+    case 1: return handlePcintButton1;
+    case 2: return handlePcintButton2;
+    case 3: return handlePcintButton3;
+    case 4: return handlePcintButton4;
+    case 5: return handlePcintButton5;
+    case 6: return handlePcintButton6;
+    default: return handlePcintButton7;
+  }
+}
+
 void handlePcintButton (uint8_t chan) {
   // check if the channel is on or off
-  if (channelOn[chan]) {
-    // turn off on next loop
-    channelTurnOffTime[chan] = millis();
+  // only called inside the ISR, so the masks can be changed directly
+  if ((channelOn | valveQueued) & CHANNEL_BIT(chan)) {
+    // turn off or remove from the queue on next loop
+    channelTurnOff |= CHANNEL_BIT(chan);
   } else {
     // turn on on next loop
-    channelTurnOn[chan] = true;
+    channelTurnOn |= CHANNEL_BIT(chan);
   }
 }
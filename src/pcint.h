@@ -8,10 +8,9 @@
 
 #include "globals.h"
 
+typedef void (*PcintHandler)(void);
+
 void handlePcintButton (uint8_t chan);
-void handlePcintButton0 (void);
-void handlePcintButton1 (void);
-void handlePcintButton2 (void);
-void handlePcintButton3 (void);
+PcintHandler pcintButtonHandler (uint8_t chan);
 
 #endif
@@ -0,0 +1,146 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Sleep modes to save power between the scheduled events.
+ */
+
+#include "powersave.h"
+
+#include "adc.h"
+
+// millisecond counter of the Arduino core, needed to correct the time after power-down sleep
+extern volatile unsigned long timer0_millis;
+
+unsigned long powersaveSleepTime = 0;
+unsigned long powersaveIdleMicros = 0;
+
+#if POWERSAVE_MODE == 2
+/**
+ * Watchdog interrupt used to wake up from power-down sleep.
+ */
+ISR (WDT_vect) {
+  // nothing to do here
+}
+#endif
+
+/**
+ * Init power saving.
+ * Must be called once at startup time.
+ */
+void powersaveInit () {
+  #if POWERSAVE_MODE != 0
+    // disable unused modules
+    power_twi_disable();
+    #if RH_DRIVER != 1
+      power_usart0_disable();
+    #endif
+  #endif
+}
+
+#if POWERSAVE_MODE == 2
+/**
+ * Enter power-down sleep for a watchdog period up to the given time.
+ * The CPU wakes up by the watchdog or a PCINT (button press).
+ * The timers are stopped while sleeping, so the millis counter is corrected
+ * by the watchdog period afterwards. On a wake up by a button press the time
+ * may run ahead up to POWERSAVE_MAX_POWER_DOWN milliseconds.
+ */
+void powersavePowerDown (unsigned long maxTime) {
+  // find the largest watchdog period fitting into the time (16ms * 2^n)
+  uint8_t wdtPrescaler = 0;
+  uint16_t sleepTime = POWERSAVE_MIN_POWER_DOWN;
+  while (wdtPrescaler < 7 && (unsigned long)sleepTime * 2 <= maxTime && sleepTime * 2 <= POWERSAVE_MAX_POWER_DOWN) {
+    wdtPrescaler++;
+    sleepTime *= 2;
+  }
+
+  cli();
+
+  // start the watchdog in interrupt mode
+  MCUSR &= ~(1<<WDRF);
+  WDTCSR = (1<<WDCE) | (1<<WDE);
+  WDTCSR = (1<<WDIE) | wdtPrescaler;
+
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  sei();
+  sleep_cpu();
+  sleep_disable();
+
+  wdt_disable();
+
+  // correct the millis counter
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    timer0_millis += sleepTime;
+  }
+  powersaveSleepTime += sleepTime;
+}
+#endif
+
+/**
+ * Sleep until the next scheduled event or an interrupt occurs.
+ * In idle sleep every interrupt (timer0, RadioHead timer, PCINT) wakes the
+ * CPU up, so this returns at least every millisecond and the main loop
+ * checks again what to do.
+ * @param idleTime Time in milliseconds until the next scheduled event.
+ */
+void powersaveSleep (unsigned long idleTime) {
+  #if ADC_NOISE_REDUCTION == 1
+    // use the adc noise reduction mode while the adc is running
+    // the adc interrupt wakes the CPU after each conversion
+    // interrupts are disabled while checking, otherwise the last conversion may
+    // finish before sleeping and nothing but a button press wakes the CPU
+    cli();
+    if (adcBusy()) {
+      set_sleep_mode(SLEEP_MODE_ADC);
+      sleep_enable();
+      sei();
+      sleep_cpu();
+      sleep_disable();
+      return;
+    }
+    sei();
+  #endif
+
+  if (idleTime == 0) {
+    return;
+  }
+
+  #if POWERSAVE_MODE == 2
+    // the adc clock stops in power-down, so a running adc sequence is finished in idle sleep
+    if (idleTime >= POWERSAVE_MIN_POWER_DOWN && !adcBusy()) {
+      powersavePowerDown(idleTime);
+      return;
+    }
+  #endif
+
+  #if POWERSAVE_MODE != 0
+    unsigned long start = micros();
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+
+    powersaveIdleMicros += micros() - start;
+    while (powersaveIdleMicros >= 1000) {
+      powersaveIdleMicros -= 1000;
+      powersaveSleepTime++;
+    }
+  #endif
+}
+
+/**
+ * Get the share of the time the CPU was awake since startup in per mille.
+ */
+uint16_t powersaveDutyCycle () {
+  unsigned long now = millis();
+  if (now < 1000) {
+    return 1000;
+  }
+  unsigned long sleepPerMille = powersaveSleepTime / (now / 1000);
+  if (sleepPerMille > 1000) {
+    return 0;
+  }
+  return 1000 - sleepPerMille;
+}
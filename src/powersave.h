@@ -0,0 +1,22 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __POWERSAVE_H__
+#define __POWERSAVE_H__
+
+#include "globals.h"
+
+// min time in milliseconds until the next event to enter power-down sleep
+// this is the shortest watchdog period
+#define POWERSAVE_MIN_POWER_DOWN 16
+
+// sum of the time spent sleeping in milliseconds
+extern unsigned long powersaveSleepTime;
+
+void powersaveInit ();
+void powersaveSleep (unsigned long idleTime);
+uint16_t powersaveDutyCycle ();
+
+#endif
@@ -8,263 +8,1036 @@
 
 #include "rh.h"
 
-#include <RH_ASK.h>
-#include <RHReliableDatagram.h>
 #include "actions.h"
+#include "history.h"
+#include "loop.h"
+#include "memory.h"
+#include "powersave.h"
+#include "sampling.h"
+#include "scheduler.h"
 #include "settings.h"
+#include "telemetry.h"
+#include "valves.h"
 
 uint8_t rhBufTx[RH_BUF_TX_LEN];
 uint8_t rhBufRx[RH_BUF_RX_LEN];
 
-RH_ASK rhDriver(RH_SPEED, RH_RX_PIN, RH_TX_PIN, RH_PTT_PIN);
-RHReliableDatagram rhManager(rhDriver, RH_OWN_ADDR);
+// queue of the frames to send
+RhTxFrame rhTxQueue[RH_TX_QUEUE_LEN];
+uint8_t rhTxQueueHead = 0;
+uint8_t rhTxQueueCount = 0;
+
+// received messages waiting to be handled
+RhRxFrame rhRxQueue[RH_RX_QUEUE_LEN];
+uint8_t rhRxQueueCount = 0;
+
+// replies collected while handling the received messages
+// [0] RH_MSG_BATCH, then the length and data of each reply
+uint8_t rhBatchBuf[RH_BUF_TX_LEN];
+uint8_t rhBatchLen = 1;
+uint8_t rhBatchCount = 0;
+uint8_t rhBatchTo;
+uint16_t rhBatchDelay;
+bool rhBatching = false;
+
+// state of the frame at the head of the queue
+uint8_t rhTxState = RH_TX_IDLE;
+uint8_t rhTxId = 0;
+uint8_t rhTxTries = 0;
+uint8_t rhTxBusyTries = 0;
+uint8_t rhTxNextHop;
+bool rhTxAcked = false;
+
+// transmit statistics
+uint8_t rhTxQueueMax = 0;
+uint16_t rhTxSent = 0;
+uint16_t rhTxRetries = 0;
+uint16_t rhTxFailed = 0;
+uint16_t rhTxDropped = 0;
+uint16_t rhTxDeferred = 0;
+uint16_t rhTxMerged = 0;
+uint16_t rhTxBusy = 0;
+
+// airtime in milliseconds in total and in each slot of the duty cycle window
+uint32_t rhAirtimeTotal = 0;
+uint32_t rhAirtimeSlots[RH_AIRTIME_SLOTS];
+uint8_t rhAirtimeSlot = 0;
+unsigned long rhAirtimeSlotStart = 0;
+
+#if RH_ROUTING == 1
+  // learned routes, the oldest one is replaced if all are used
+  RhRoute rhRoutes[RH_ROUTES];
+  uint8_t rhRouteCount = 0;
+  uint8_t rhRouteReplace = 0;
+
+  // id of the next routed message from this node
+  uint8_t rhRouteId = 0;
+
+  // route statistics
+  uint16_t rhRouteForwarded = 0;
+  uint16_t rhRouteDropped = 0;
+  uint8_t rhRouteServerHops = 0xFF; // hops of the last message from the server, 0xFF if unknown
+#endif
+
+#if POWERSAVE_MODE == 2
+  // time until the receiver is active in power-down mode
+  unsigned long rhListenUntil = 0;
+#endif
+
+// id of the last received message of the recent senders to detect retransmissions
+RhRxSeen rhRxSeen[RH_RX_SEEN_LEN];
+uint8_t rhRxSeenCount = 0;
+uint8_t rhRxSeenReplace = 0;
+
+// the acknowledges and retries of RHReliableDatagram are done by the transmit
+// task here, so only the plain datagram manager is used
+#if RH_DRIVER == 0
+  RH_ASK rhDriver(RH_SPEED, RH_RX_PIN, RH_TX_PIN, RH_PTT_PIN);
+#elif RH_DRIVER == 69
+  RH_RF69 rhDriver(RH_RF_CS_PIN, RH_RF_INT_PIN);
+#elif RH_DRIVER == 95
+  RH_RF95 rhDriver(RH_RF_CS_PIN, RH_RF_INT_PIN);
+#elif RH_DRIVER == 1
+  RH_Serial rhDriver(Serial);
+#endif
+RHDatagram rhManager(rhDriver, RH_OWN_ADDR);
 
 /**
  * Init RadioHead.
  * Must be called once at startup time.
  */
 void rhInit () {
+  #if RH_DRIVER == 1
+    Serial.begin(RH_SERIAL_SPEED);
+  #endif
+
   if (!rhManager.init()) {
     // blink error if init failed
     while (true) {
-      blinkCode(BLINK_CODE_RH_INIT_ERROR);
+      blinkCodeBlocking(BLINK_CODE_RH_INIT_ERROR);
       delay(1000);
     }
   }
-  rhManager.setRetries(RH_SEND_RETRIES);
-  rhManager.setTimeout(RH_SEND_TIMEOUT);
+
+  #if RH_DRIVER == 69 || RH_DRIVER == 95
+    rhDriver.setFrequency(RH_RF_FREQUENCY);
+    rhDriver.setTxPower(RH_RF_TX_POWER);
+  #endif
   rhManager.setThisAddress(settings.ownAddress); // apply own address from settings
 }
 
 /**
- * Function to receive a RadioHead message if a new message is available.
+ * Keep the receiver active for RH_LISTEN_TIME from now on.
+ * Only needed in power-down mode, otherwise the receiver is always active.
  */
-void rhRecv () {
-  if (rhManager.available()) {
-    uint8_t rhRxLen = RH_BUF_RX_LEN;
-    uint8_t rhRxFrom;
-    uint8_t rhRxTo;
-    if (rhManager.recvfromAck(rhBufRx, &rhRxLen, &rhRxFrom, &rhRxTo)) {
-      // blink to show that we received something
-      blinkCode(BLINK_CODE_RH_RECV);
-
-      // make sure the message is send to our own address and has at least one byte
-      if (rhRxTo != RH_OWN_ADDR || rhRxLen < 1) {
+void rhListen (unsigned long now) {
+  #if POWERSAVE_MODE == 2
+    rhListenUntil = now + RH_LISTEN_TIME;
+    if (!schedulerIsSet(TASK_RH_POLL)) {
+      schedulerSet(TASK_RH_POLL, now);
+    }
+  #endif
+}
+
+/**
+ * Disable the receiver until the next call of rhListen().
+ */
+void rhStopListening () {
+  rhDriver.setModeIdle();
+}
+
+/**
+ * Drop the slots of the duty cycle window which are older than the window.
+ */
+void rhAirtimeRotate (unsigned long now) {
+  if (now - rhAirtimeSlotStart >= RH_AIRTIME_SLOT_TIME * RH_AIRTIME_SLOTS) {
+    // nothing send within the whole window
+    memset(rhAirtimeSlots, 0, sizeof(rhAirtimeSlots));
+    rhAirtimeSlotStart = now;
+    return;
+  }
+  while (now - rhAirtimeSlotStart >= RH_AIRTIME_SLOT_TIME) {
+    rhAirtimeSlot = (rhAirtimeSlot + 1) % RH_AIRTIME_SLOTS;
+    rhAirtimeSlots[rhAirtimeSlot] = 0;
+    rhAirtimeSlotStart += RH_AIRTIME_SLOT_TIME;
+  }
+}
+
+/**
+ * Account the airtime of a transmitted frame.
+ * @param len Length of the message without the headers.
+ */
+void rhAirtimeAdd (uint8_t len) {
+  uint32_t airtime = RH_AIRTIME(len);
+  rhAirtimeRotate(millis());
+  rhAirtimeSlots[rhAirtimeSlot] += airtime;
+  rhAirtimeTotal += airtime;
+}
+
+/**
+ * Get the airtime in milliseconds used within the duty cycle window.
+ */
+uint32_t rhAirtimeUsed () {
+  rhAirtimeRotate(millis());
+  uint32_t used = 0;
+  for (uint8_t slot = 0; slot < RH_AIRTIME_SLOTS; slot++) {
+    used += rhAirtimeSlots[slot];
+  }
+  return used;
+}
+
+/**
+ * Check if the duty cycle budget for pushed values is used up.
+ * The rest of the budget is reserved for valve state changes and replies.
+ */
+bool rhAirtimeLow () {
+  #if RH_DUTY_CYCLE > 0
+    return rhAirtimeUsed() >= RH_AIRTIME_PUSH_BUDGET;
+  #else
+    return false;
+  #endif
+}
+
+/**
+ * Get the time when the oldest slot is dropped from the duty cycle window.
+ */
+unsigned long rhAirtimeFreeAt () {
+  rhAirtimeRotate(millis());
+  return rhAirtimeSlotStart + RH_AIRTIME_SLOT_TIME;
+}
+
+#if RH_ROUTING == 1
+/**
+ * Learn the route to the source of a received routed message.
+ * The neighbour the message came from is the next hop back to the source.
+ */
+void rhRouteLearn (uint8_t dest, uint8_t nextHop, uint8_t hops) {
+  RhRoute *route = NULL;
+  for (uint8_t i = 0; i < rhRouteCount; i++) {
+    if (rhRoutes[i].dest == dest) {
+      route = &rhRoutes[i];
+      break;
+    }
+  }
+
+  if (!route) {
+    if (rhRouteCount < RH_ROUTES) {
+      route = &rhRoutes[rhRouteCount++];
+    } else {
+      route = &rhRoutes[rhRouteReplace];
+      rhRouteReplace = (rhRouteReplace + 1) % RH_ROUTES;
+    }
+    route->dest = dest;
+  }
+  route->nextHop = nextHop;
+  route->hops = hops;
+}
+
+/**
+ * Get the neighbour to send a message for the destination to.
+ * The next hop to the server is taken from the settings, the others from the
+ * learned routes. Without a route the message is send directly.
+ */
+uint8_t rhRouteNextHop (uint8_t dest) {
+  if (dest == settings.serverAddress && settings.routeVia != RH_BROADCAST_ADDRESS) {
+    return settings.routeVia;
+  }
+  for (uint8_t i = 0; i < rhRouteCount; i++) {
+    if (rhRoutes[i].dest == dest) {
+      return rhRoutes[i].nextHop;
+    }
+  }
+  return dest;
+}
+#endif
+
+/**
+ * Check if a message is a retransmission of the last message of the sender.
+ * Otherwise the id is stored as the last one of the sender.
+ * @return `true` if the message was already received.
+ */
+bool rhRxIsSeen (uint8_t from, uint8_t id) {
+  RhRxSeen *seen = NULL;
+  for (uint8_t i = 0; i < rhRxSeenCount; i++) {
+    if (rhRxSeen[i].from == from) {
+      seen = &rhRxSeen[i];
+      break;
+    }
+  }
+
+  if (!seen) {
+    if (rhRxSeenCount < RH_RX_SEEN_LEN) {
+      seen = &rhRxSeen[rhRxSeenCount++];
+    } else {
+      seen = &rhRxSeen[rhRxSeenReplace];
+      rhRxSeenReplace = (rhRxSeenReplace + 1) % RH_RX_SEEN_LEN;
+    }
+    seen->from = from;
+  } else if (seen->id == id) {
+    return true;
+  }
+
+  seen->id = id;
+  return false;
+}
+
+/**
+ * Function to receive a message and handle the acknowledges.
+ * Received acknowledges are passed to the transmit task and each new message
+ * to this node is acknowledged.
+ * @return `true` if a new message (no acknowledge and no retransmission) was received.
+ */
+bool rhRecvfromAck (uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to) {
+  uint8_t id;
+  uint8_t flags;
+  if (!rhManager.recvfrom(buf, len, from, to, &id, &flags)) {
+    return false;
+  }
+
+  if (flags & RH_FLAGS_ACK) {
+    // check if this is the acknowledge for the frame we are waiting for
+    if (rhTxState != RH_TX_IDLE && *from == rhTxNextHop && id == rhTxId) {
+      rhTxAcked = true;
+      schedulerSet(TASK_RH_SEND, millis());
+    }
+    return false;
+  }
+
+  if (*to == settings.ownAddress) {
+    // acknowledge the message with the ack flag and the received id
+    // the ack is not waited for, the transmit task waits for the driver if needed
+    uint8_t ack = '!';
+    rhManager.setHeaderId(id);
+    rhManager.setHeaderFlags(RH_FLAGS_ACK);
+    rhManager.sendto(&ack, sizeof(ack), *from);
+    rhAirtimeAdd(sizeof(ack));
+  }
+
+  // ignore retransmissions of a message we have already seen
+  return !rhRxIsSeen(*from, id);
+}
+
+/**
+ * Update everything depending on changed settings.
+ * @param affects The SETTINGS_AFFECTS_* flags of the changed settings.
+ */
+void rhApplySettings (uint8_t affects) {
+  if (affects & SETTINGS_AFFECTS_OWN_ADDRESS) {
+    rhManager.setThisAddress(settings.ownAddress);
+  }
+
+  if (affects & SETTINGS_AFFECTS_TEMP_SWITCH) {
+    calcTempSwitchTriggerValues();
+  }
+
+  // calc new read times
+  // temperature sensor read is 5 seconds before adc read to avoid both readings at the same time
+  #if TEMP_SENSOR_TYPE != 0
+    if (affects & SETTINGS_AFFECTS_TEMP_SENSOR) {
+      schedulerSet(TASK_TEMP_SENSOR, millis() - 5000 + ((uint32_t)settings.tempSensorInterval * 1000));
+    }
+  #endif
+  if (affects & SETTINGS_AFFECTS_ADC_READ) {
+    scheduleAdcRead(millis() + ((uint32_t)samplingCheckInterval() * 1000));
+  }
+
+  if (affects & SETTINGS_AFFECTS_HEARTBEAT) {
+    telemetryRestartHeartbeat();
+  }
+
+  if (affects & SETTINGS_AFFECTS_VALVE_QUEUE) {
+    // more valves may be opened now
+    schedulerSet(TASK_VALVE_QUEUE, millis());
+  }
+}
+
+/**
+ * Add a frame to the transmit queue, the caller sets the data.
+ * @return The frame or `NULL` if the queue is full.
+ */
+RhTxFrame *rhTxQueueAdd (uint8_t sendTo, uint16_t delayAfterSend) {
+  if (rhTxQueueCount >= RH_TX_QUEUE_LEN) {
+    rhTxDropped++;
+    blinkCode(BLINK_CODE_RH_SEND_ERROR);
+    return NULL;
+  }
+
+  RhTxFrame *frame = &rhTxQueue[(rhTxQueueHead + rhTxQueueCount) % RH_TX_QUEUE_LEN];
+  frame->to = sendTo;
+  frame->delayAfterSend = delayAfterSend;
+
+  rhTxQueueCount++;
+  if (rhTxQueueCount > rhTxQueueMax) {
+    rhTxQueueMax = rhTxQueueCount;
+  }
+
+  // start the transmit task if it is not already running
+  if (!schedulerIsSet(TASK_RH_SEND)) {
+    schedulerSet(TASK_RH_SEND, millis());
+  }
+  return frame;
+}
+
+/**
+ * Copy a frame into the transmit queue.
+ * @return `true` if the frame is queued, `false` if the queue is full.
+ */
+bool rhQueue (const uint8_t *data, uint8_t len, uint8_t sendTo, uint16_t delayAfterSend) {
+  RhTxFrame *frame = rhTxQueueAdd(sendTo, delayAfterSend);
+  if (!frame) {
+    return false;
+  }
+
+  #if RH_ROUTING == 1
+    // route header of a message from this node
+    frame->data[0] = sendTo;
+    frame->data[1] = settings.ownAddress;
+    frame->data[2] = 0;
+    frame->data[3] = rhRouteId++;
+    frame->data[4] = 0;
+  #endif
+  memcpy(&frame->data[RH_ROUTE_HEADER_LEN], data, len);
+  frame->len = RH_ROUTE_HEADER_LEN + len;
+  return true;
+}
+
+#if RH_ROUTING == 1
+/**
+ * Queue a received routed message for another node to relay it.
+ * The message is only copied and send by the transmit task like the own
+ * messages, so relaying doesn't delay the valves.
+ */
+void rhRouteForward (RhRxFrame *rx) {
+  if (rx->data[2] >= RH_MAX_HOPS) {
+    rhRouteDropped++;
+    return;
+  }
+
+  RhTxFrame *frame = rhTxQueueAdd(rx->data[0], 0);
+  if (!frame) {
+    rhRouteDropped++;
+    return;
+  }
+  memcpy(frame->data, rx->data, rx->len);
+  frame->data[2]++;
+  frame->len = rx->len;
+  rhRouteForwarded++;
+}
+#endif
+
+/**
+ * Queue the collected replies.
+ * A single reply is send as it is, multiple replies as one batch frame.
+ */
+void rhBatchFlush () {
+  if (rhBatchCount == 1) {
+    rhQueue(&rhBatchBuf[2], rhBatchBuf[1], rhBatchTo, rhBatchDelay);
+  } else if (rhBatchCount > 1) {
+    rhBatchBuf[0] = RH_MSG_BATCH;
+    rhQueue(rhBatchBuf, rhBatchLen, rhBatchTo, rhBatchDelay);
+  }
+  rhBatchLen = 1;
+  rhBatchCount = 0;
+}
+
+/**
+ * Get the number of used transmit queue slots including the collected replies.
+ */
+uint8_t rhTxQueueUsed () {
+  return rhTxQueueCount + (rhBatchCount > 0 ? 1 : 0);
+}
+
+/**
+ * Handle a received message in rhBufRx.
+ * @param rhRxFrom Address of the sender.
+ * @param rhRxLen  Length of the message including the type byte.
+ */
+void rhHandle (uint8_t rhRxFrom, uint8_t rhRxLen) {
+  switch (rhBufRx[0]) {
+    case RH_MSG_GET_SETTINGS:
+      // request to send the current settings
+      // bit 0..3 indicate the enabled channels
+      // only the first four channels fit into this message, the others are send as RH_MSG_CHANNEL_SETTINGS
+      rhBufTx[1] = settings.channelEnabled & 0x0F;
+      memset(&rhBufTx[2], 0, 16);
+      for (uint8_t chan = 0; chan < RH_SETTINGS_CHANNELS; chan++) {
+        memcpy(&rhBufTx[2+chan*2], &settings.adcTriggerValue[chan], 2);
+        memcpy(&rhBufTx[10+chan*2], &settings.wateringTime[chan], 2);
+      }
+      // bit 7 indicate if sending the adc values is enabled
+      if (settings.sendAdcValuesThroughRH) {
+        rhBufTx[1] |= (1 << 7);
+      }
+      // bit 6 indicate if data push is enabled
+      if (settings.pushDataEnabled) {
+        rhBufTx[1] |= (1 << 6);
+      }
+      // bit 5 indicate if temperature switch is inverted
+      if (settings.tempSwitchInverted) {
+        rhBufTx[1] |= (1 << 5);
+      }
+
+      memcpy(&rhBufTx[18], &settings.checkInterval, 2);
+      memcpy(&rhBufTx[20], &settings.tempSensorInterval, 2);
+      rhBufTx[22] = settings.serverAddress;
+      rhBufTx[23] = settings.ownAddress;
+      memcpy(&rhBufTx[24], &settings.delayAfterSend, 2);
+      rhBufTx[26] = settings.tempSwitchTriggerValue;
+      rhBufTx[27] = settings.tempSwitchHystTenth;
+
+      rhSend(RH_MSG_SETTINGS, 28, rhRxFrom);
+      break;
+
+    case RH_MSG_SET_SETTINGS: {
+      // got new settings
+      if (rhRxLen < 28) {
         return;
       }
+      // only changed intervals restart their timers
+      uint8_t affects = SETTINGS_AFFECTS_TEMP_SWITCH;
+      if (memcmp(&settings.checkInterval, &rhBufRx[18], 2) != 0) {
+        affects |= SETTINGS_AFFECTS_ADC_READ;
+      }
+      if (memcmp(&settings.tempSensorInterval, &rhBufRx[20], 2) != 0) {
+        affects |= SETTINGS_AFFECTS_TEMP_SENSOR;
+      }
+      if (settings.ownAddress != rhBufRx[23]) {
+        affects |= SETTINGS_AFFECTS_OWN_ADDRESS;
+      }
 
-      switch (rhBufRx[0]) {
-        case RH_MSG_GET_SETTINGS:
-          // request to send the current settings
-          rhBufTx[1] = 0;
-          for (uint8_t chan = 0; chan < 4; chan++) {
-            // bit 0..3 indicate the enabled channels
-            if (settings.channelEnabled[chan]) {
-              rhBufTx[1] |= (1 << chan);
-            }
-            memcpy(&rhBufTx[2+chan*2], &settings.adcTriggerValue[chan], 2);
-            memcpy(&rhBufTx[10+chan*2], &settings.wateringTime[chan], 2);
-          }
-          // bit 7 indicate if sending the adc values is enabled
-          if (settings.sendAdcValuesThroughRH) {
-            rhBufTx[1] |= (1 << 7);
-          }
-          // bit 6 indicate if data push is enabled
-          if (settings.pushDataEnabled) {
-            rhBufTx[1] |= (1 << 6);
-          }
-          // bit 5 indicate if temperature switch is inverted
-          if (settings.tempSwitchInverted) {
-            rhBufTx[1] |= (1 << 5);
-          }
+      // the channels after the first four are kept
+      settings.channelEnabled = (settings.channelEnabled & ~0x0F) | (rhBufRx[1] & 0x0F & CHANNEL_MASK_ALL);
+      for (uint8_t chan = 0; chan < RH_SETTINGS_CHANNELS; chan++) {
+        memcpy(&settings.adcTriggerValue[chan], &rhBufRx[2+chan*2], 2);
+        memcpy(&settings.wateringTime[chan], &rhBufRx[10+chan*2], 2);
+      }
+      settings.sendAdcValuesThroughRH = ((rhBufRx[1] & (1 << 7)) != 0);
+      settings.pushDataEnabled = ((rhBufRx[1] & (1 << 6)) != 0);
+      settings.tempSwitchInverted = ((rhBufRx[1] & (1 << 5)) != 0);
+      memcpy(&settings.checkInterval, &rhBufRx[18], 2);
+      memcpy(&settings.tempSensorInterval, &rhBufRx[20], 2);
+      settings.serverAddress = rhBufRx[22];
+      settings.ownAddress = rhBufRx[23];
+      memcpy(&settings.delayAfterSend, &rhBufRx[24], 2);
+      settings.tempSwitchTriggerValue = rhBufRx[26];
+      settings.tempSwitchHystTenth = rhBufRx[27];
 
-          memcpy(&rhBufTx[18], &settings.checkInterval, 2);
-          memcpy(&rhBufTx[20], &settings.tempSensorInterval, 2);
-          rhBufTx[22] = settings.serverAddress;
-          rhBufTx[23] = settings.ownAddress;
-          memcpy(&rhBufTx[24], &settings.delayAfterSend, 2);
-          rhBufTx[26] = settings.tempSwitchTriggerValue;
-          rhBufTx[27] = settings.tempSwitchHystTenth;
+      rhApplySettings(affects);
+      break;
+    }
 
-          rhSend(RH_MSG_SETTINGS, 28, rhRxFrom);
+    case RH_MSG_PATCH_SETTINGS: {
+      // got (field id, value) pairs of changed settings
+      // stops at the first unknown field or incomplete value
+      uint8_t affects = 0;
+      uint8_t count = 0;
+      uint8_t pos = 1;
+      while (pos < rhRxLen) {
+        uint8_t size = patchSetting(rhBufRx[pos], &rhBufRx[pos + 1], rhRxLen - pos - 1, &affects);
+        if (size == 0) {
           break;
+        }
+        pos += 1 + size;
+        count++;
+      }
 
-        case RH_MSG_SET_SETTINGS:
-          // got new settings
-          if (rhRxLen < 28) {
-            return;
-          }
-          for (uint8_t chan = 0; chan < 4; chan++) {
-            settings.channelEnabled[chan] = ((rhBufRx[1] & (1 << chan)) != 0);
-            memcpy(&settings.adcTriggerValue[chan], &rhBufRx[2+chan*2], 2);
-            memcpy(&settings.wateringTime[chan], &rhBufRx[10+chan*2], 2);
-          }
-          settings.sendAdcValuesThroughRH = ((rhBufRx[1] & (1 << 7)) != 0);
-          settings.pushDataEnabled = ((rhBufRx[1] & (1 << 6)) != 0);
-          settings.tempSwitchInverted = ((rhBufRx[1] & (1 << 5)) != 0);
-          memcpy(&settings.checkInterval, &rhBufRx[18], 2);
-          memcpy(&settings.tempSensorInterval, &rhBufRx[20], 2);
-          settings.serverAddress = rhBufRx[22];
-
-          // apply changed own address
-          if (settings.ownAddress != rhBufRx[23]) {
-            settings.ownAddress = rhBufRx[23];
-            rhManager.setThisAddress(settings.ownAddress);
-          }
+      rhApplySettings(affects);
 
-          memcpy(&settings.delayAfterSend, &rhBufRx[24], 2);
+      // ack with the number of applied fields and the rejected field
+      rhBufTx[1] = count;
+      rhBufTx[2] = (pos < rhRxLen) ? rhBufRx[pos] : RH_SETTINGS_PATCH_OK;
+      rhSend(RH_MSG_SETTINGS_PATCHED, 3, rhRxFrom);
+      break;
+    }
 
-          settings.tempSwitchTriggerValue = rhBufRx[26];
-          settings.tempSwitchHystTenth = rhBufRx[27];
+    case RH_MSG_GET_CHANNEL_SETTINGS:
+      // request to send the settings of one channel
+      if (rhRxLen < 2 || rhBufRx[1] >= CHANNEL_COUNT) {
+        return;
+      }
+      rhBufTx[1] = rhBufRx[1];
+      rhBufTx[2] = (settings.channelEnabled & CHANNEL_BIT(rhBufRx[1])) ? 0x01 : 0x00;
+      memcpy(&rhBufTx[3], &settings.adcTriggerValue[rhBufRx[1]], 2);
+      memcpy(&rhBufTx[5], &settings.wateringTime[rhBufRx[1]], 2);
 
-          // calc temperature switch high/low trigger values
-          calcTempSwitchTriggerValues();
+      rhSend(RH_MSG_CHANNEL_SETTINGS, 7, rhRxFrom);
+      break;
 
-          // calc new read times
-          // temperature sensor read is 5 seconds before adc read to avoid both readings at the same time
-          tempSensorNextReadTime = millis() - 5000 + ((uint32_t)settings.tempSensorInterval * 1000);
-          adcNextReadTime = millis() + ((uint32_t)settings.checkInterval * 1000);
-          break;
+    case RH_MSG_GET_EXT_SETTINGS:
+      // request to send the current extended settings
+      rhBufTx[1] = settings.adcOversampling;
+      rhBufTx[2] = settings.adcFilterType;
+      rhBufTx[3] = settings.adcFilterDepth;
+      rhBufTx[4] = settings.pushOnChange ? 0x01 : 0x00;
+      rhBufTx[5] = settings.deadbandAdc;
+      rhBufTx[6] = settings.deadbandTempTenth;
+      rhBufTx[7] = settings.deadbandBattery;
+      memcpy(&rhBufTx[8], &settings.heartbeatInterval, 2);
+      rhBufTx[10] = settings.valveMax;
+      memcpy(&rhBufTx[11], &settings.valveGap, 2);
+      rhBufTx[13] = settings.valveOrder;
+      rhBufTx[14] = settings.checkAdaptive ? 0x01 : 0x00;
+      memcpy(&rhBufTx[15], &settings.checkIntervalMin, 2);
+      memcpy(&rhBufTx[17], &settings.checkIntervalMax, 2);
+      memcpy(&rhBufTx[19], &settings.sensorsWarmup, 2);
+      rhBufTx[21] = settings.settleTolerance;
+      rhBufTx[22] = settings.routeVia;
 
-        case RH_MSG_SAVE_SETTINGS:
-          // save the current settings into the eeprom
-          saveSettings();
-          break;
+      rhSend(RH_MSG_EXT_SETTINGS, 23, rhRxFrom);
+      break;
 
-        case RH_MSG_CHECK_NOW:
-          // set the next adc read time to now plus two seconds to start a check
-          adcNextReadTime = millis() + 2000;
-          break;
+    case RH_MSG_SET_EXT_SETTINGS:
+      // got new extended settings
+      // the values are in the order of the setting fields starting at the adc oversampling,
+      // so they are set like a patch and only the timers of changed values are restarted
+      // a shorter frame (e.g. from an older control app) sets only the leading fields it
+      // contains completely, the following fields are not changed
+      {
+        uint8_t affects = 0;
+        uint8_t pos = 1;
+        for (uint8_t field = SETTING_ADC_OVERSAMPLING; field <= SETTING_ROUTE_VIA && pos < rhRxLen; field++) {
+          uint8_t size = patchSetting(field, &rhBufRx[pos], rhRxLen - pos, &affects);
+          if (size == 0) {
+            break;
+          }
+          pos += size;
+        }
+        rhApplySettings(affects);
+      }
+      break;
 
-        case RH_MSG_TURN_CHANNEL_ON_OFF:
-          if (rhRxLen < 5) return;
+    case RH_MSG_SAVE_SETTINGS:
+      // save the current settings into the eeprom
+      saveSettings();
+      break;
 
-          for (uint8_t chan = 0; chan < 4; chan++) {
-            if (!settings.channelEnabled[chan]) continue;
+    case RH_MSG_CHECK_NOW:
+      // set the next adc read time to now plus two seconds to start a check
+      scheduleAdcRead(millis() + 2000);
+      break;
 
-            if (rhBufRx[chan + 1] == 0x01 && !channelOn[chan]) {
-              // set marker to turn the channel on
-              channelTurnOn[chan] = true;
-            } else if (rhBufRx[chan + 1] == 0x00 && channelOn[chan]) {
-              // set the turn off time for channel to now
-              channelTurnOffTime[chan] = millis();
-            }
-          }
-          break;
+    case RH_MSG_TURN_CHANNEL_ON_OFF:
+      // one byte per channel, channels without a byte are not changed
+      for (uint8_t chan = 0; chan < CHANNEL_COUNT && chan + 1 < rhRxLen; chan++) {
+        if (!(settings.channelEnabled & CHANNEL_BIT(chan))) continue;
 
-        case RH_MSG_TURN_TEMP_SWITCH_ON_OFF:
-          // temperature switch on/off
-          if (rhRxLen < 2) {
-            return;
-          }
-          if (rhBufRx[1] == 0x01) {
-            digitalWrite(TEMP_SWITCH_PIN, HIGH);
-            tempSwitchOn = true;
-          } else {
-            digitalWrite(TEMP_SWITCH_PIN, LOW);
-            tempSwitchOn = false;
-          }
-          rhSendData(RH_MSG_TEMP_SENSOR_DATA, RH_FORCE_SEND, rhRxFrom);
-          break;
+        if (rhBufRx[chan + 1] == 0x01 && !(channelOn & CHANNEL_BIT(chan))) {
+          // set marker to turn the channel on
+          channelMaskSet(channelTurnOn, chan);
+        } else if (rhBufRx[chan + 1] == 0x00 && ((channelOn | valveQueued) & CHANNEL_BIT(chan))) {
+          // set marker to turn the channel off or remove it from the queue
+          channelMaskSet(channelTurnOff, chan);
+        }
+      }
+      break;
 
-        case RH_MSG_PAUSE:
-          // enable pause
-          pauseAutomatic = true;
-          break;
+    case RH_MSG_TURN_TEMP_SWITCH_ON_OFF:
+      // temperature switch on/off
+      if (rhRxLen < 2) {
+        return;
+      }
+      if (rhBufRx[1] == 0x01) {
+        digitalWrite(TEMP_SWITCH_PIN, HIGH);
+        tempSwitchOn = true;
+      } else {
+        digitalWrite(TEMP_SWITCH_PIN, LOW);
+        tempSwitchOn = false;
+      }
+      rhSendData(RH_MSG_TEMP_SENSOR_DATA, RH_FORCE_SEND, rhRxFrom);
+      break;
 
-        case RH_MSG_RESUME:
-          // resume from pause
-          pauseAutomatic = false;
-          break;
+    case RH_MSG_PAUSE:
+      // enable pause
+      pauseAutomatic = true;
+      break;
 
-        case RH_MSG_PAUSE_ON_OFF:
-          // pause on/off
-          if (rhRxLen < 2) {
-            return;
-          }
-          if (rhBufRx[1] == 0x01) {
-            // enable pause
-            pauseAutomatic = true;
-          } else {
-            // resume from pause
-            pauseAutomatic = false;
-          }
-          break;
+    case RH_MSG_RESUME:
+      // resume from pause
+      pauseAutomatic = false;
+      break;
+
+    case RH_MSG_PAUSE_ON_OFF:
+      // pause on/off
+      if (rhRxLen < 2) {
+        return;
+      }
+      if (rhBufRx[1] == 0x01) {
+        // enable pause
+        pauseAutomatic = true;
+      } else {
+        // resume from pause
+        pauseAutomatic = false;
+      }
+      break;
 
-        case RH_MSG_POLL_DATA:
-          // poll data
-          if (rhRxLen >= 2) {
-            // poll with data
-            switch (rhBufRx[1]) {
-              case RH_MSG_BATTERY:
-                #if BAT_ENABLED == 1
-                  rhSendData(RH_MSG_BATTERY, RH_FORCE_SEND, rhRxFrom);
-                #endif
-                break;
-              case RH_MSG_CHANNEL_STATE:
-                rhSendData(RH_MSG_CHANNEL_STATE, RH_FORCE_SEND, rhRxFrom);
-                break;
-              case RH_MSG_TEMP_SENSOR_DATA:
-                rhSendData(RH_MSG_TEMP_SENSOR_DATA, RH_FORCE_SEND, rhRxFrom);
-                break;
-              case RH_MSG_SENSOR_VALUES:
-                rhSendData(RH_MSG_SENSOR_VALUES, RH_FORCE_SEND, rhRxFrom);
-                break;
-              default:
-                // no known poll request... send all
-                #if BAT_ENABLED == 1
-                  rhSendData(RH_MSG_BATTERY, RH_FORCE_SEND, rhRxFrom);
-                #endif
-                rhSendData(RH_MSG_CHANNEL_STATE, RH_FORCE_SEND, rhRxFrom);
-                rhSendData(RH_MSG_TEMP_SENSOR_DATA, RH_FORCE_SEND, rhRxFrom);
-                rhSendData(RH_MSG_SENSOR_VALUES, RH_FORCE_SEND, rhRxFrom);
-            }
-          } else {
-            // poll without data... send all
+    case RH_MSG_POLL_DATA:
+      // poll data
+      if (rhRxLen >= 2) {
+        // poll with data
+        switch (rhBufRx[1]) {
+          case RH_MSG_BATTERY:
             #if BAT_ENABLED == 1
               rhSendData(RH_MSG_BATTERY, RH_FORCE_SEND, rhRxFrom);
             #endif
+            break;
+          case RH_MSG_CHANNEL_STATE:
             rhSendData(RH_MSG_CHANNEL_STATE, RH_FORCE_SEND, rhRxFrom);
+            break;
+          case RH_MSG_TEMP_SENSOR_DATA:
             rhSendData(RH_MSG_TEMP_SENSOR_DATA, RH_FORCE_SEND, rhRxFrom);
+            break;
+          case RH_MSG_SENSOR_VALUES:
             rhSendData(RH_MSG_SENSOR_VALUES, RH_FORCE_SEND, rhRxFrom);
-          }
-          break;
+            break;
+          default:
+            // no known poll request... send all in one message
+            rhSendData(RH_MSG_TELEMETRY, RH_FORCE_SEND, rhRxFrom);
+        }
+      } else {
+        // poll without data... send all in one message
+        rhSendData(RH_MSG_TELEMETRY, RH_FORCE_SEND, rhRxFrom);
+      }
+      break;
 
-        case RH_MSG_GET_VERSION:
-          // send the software version
-          rhSendData(RH_MSG_VERSION, RH_FORCE_SEND, rhRxFrom);
-          break;
+    case RH_MSG_GET_VERSION:
+      // send the software version
+      rhSendData(RH_MSG_VERSION, RH_FORCE_SEND, rhRxFrom);
+      break;
 
-        case RH_MSG_PING:
-          // respond to a ping with the received data
-          for (uint8_t i = 1; i < rhRxLen; i++) {
-            rhBufTx[i] = rhBufRx[i];
-          }
-          rhSend(RH_MSG_PONG, rhRxLen, rhRxFrom); // use rhSend directly to allow variable data length
-          break;
+    case RH_MSG_PING:
+      // respond to a ping with the received data
+      for (uint8_t i = 1; i < rhRxLen; i++) {
+        rhBufTx[i] = rhBufRx[i];
       }
+      rhSend(RH_MSG_PONG, rhRxLen, rhRxFrom); // use rhSend directly to allow variable data length
+      break;
+
+    case RH_MSG_GET_TX_STATS:
+      // send the transmit statistics
+      rhSendData(RH_MSG_TX_STATS, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_POWER_STATS:
+      // send the power saving statistics
+      rhSendData(RH_MSG_POWER_STATS, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_LOOP_STATS:
+      // send the loop pass statistics
+      rhSendData(RH_MSG_LOOP_STATS, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_MEMORY_STATS:
+      // send the memory usage
+      rhSendData(RH_MSG_MEMORY_STATS, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_VALVE_QUEUE:
+      // send the state of the pending watering queue
+      rhSendData(RH_MSG_VALVE_QUEUE, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_SENSOR_STATS:
+      // send the settle times of the sensors
+      rhSendData(RH_MSG_SENSOR_STATS, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_ROUTE_STATS:
+      // send the route statistics and the learned routes
+      rhSendData(RH_MSG_ROUTE_STATS, RH_FORCE_SEND, rhRxFrom);
+      break;
+
+    case RH_MSG_GET_TASK_STATS:
+      // send the max lateness and run time of each task in [3..], split into multiple messages
+      // [1] first task id in the message, [2] number of tasks in the message
+      for (uint8_t first = 0; first < SCHEDULER_TASK_COUNT; first += RH_TASK_STATS_PER_MSG) {
+        uint8_t count = min(SCHEDULER_TASK_COUNT - first, RH_TASK_STATS_PER_MSG);
+        rhBufTx[1] = first;
+        rhBufTx[2] = count;
+        for (uint8_t i = 0; i < count; i++) {
+          memcpy(&rhBufTx[3 + i * 4], &schedulerMaxLateness[first + i], 2);
+          memcpy(&rhBufTx[5 + i * 4], &schedulerMaxRunTime[first + i], 2);
+        }
+        rhSend(RH_MSG_TASK_STATS, 3 + count * 4, rhRxFrom);
+      }
+      break;
+
+    case RH_MSG_GET_HISTORY:
+      // send the history starting at the sequence number in [1..2], max number of chunks in [3]
+      #if HISTORY_ENABLED == 1
+        {
+          if (rhRxLen < 3) return;
+          uint16_t seq;
+          memcpy(&seq, &rhBufRx[1], 2);
+          historySend(seq, (rhRxLen >= 4) ? rhBufRx[3] : 0, rhRxFrom);
+        }
+      #endif
+      break;
+  }
+}
+
+/**
+ * Function to receive all available RadioHead messages.
+ * The messages are received into the receive queue first, so no message is
+ * lost in the driver while handling the others. Then they are handled in
+ * order and the replies to the same sender are collected into batch frames.
+ */
+void rhRecv () {
+  bool received = false;
+  rhRxQueueCount = 0;
+  while (rhRxQueueCount < RH_RX_QUEUE_LEN && rhManager.available()) {
+    RhRxFrame *frame = &rhRxQueue[rhRxQueueCount];
+    uint8_t to;
+    frame->len = sizeof(frame->data);
+    if (!rhRecvfromAck(frame->data, &frame->len, &frame->from, &to)) {
+      continue;
+    }
+    received = true;
+
+    // make sure the message is send to our own address and has at least one byte
+    if (to == settings.ownAddress && frame->len >= RH_ROUTE_HEADER_LEN + 1) {
+      #if RH_ROUTING == 1
+        // learn the way back to the source
+        rhRouteLearn(frame->data[1], frame->from, frame->data[2]);
+
+        if (frame->data[0] != settings.ownAddress && frame->data[0] != RH_BROADCAST_ADDRESS) {
+          // relay the message for another node
+          rhRouteForward(frame);
+          continue;
+        }
+
+        // handle the message as send by the source
+        if (frame->data[1] == settings.serverAddress) {
+          rhRouteServerHops = frame->data[2];
+        }
+        frame->from = frame->data[1];
+      #endif
+      rhRxQueueCount++;
     }
   }
+
+  if (!received) {
+    return;
+  }
+
+  // blink to show that we received something
+  blinkCode(BLINK_CODE_RH_RECV);
+
+  // keep listening for further messages
+  rhListen(millis());
+
+  rhBatching = true;
+  for (uint8_t i = 0; i < rhRxQueueCount; i++) {
+    uint8_t len = rhRxQueue[i].len - RH_ROUTE_HEADER_LEN;
+    memcpy(rhBufRx, &rhRxQueue[i].data[RH_ROUTE_HEADER_LEN], len);
+    rhHandle(rhRxQueue[i].from, len);
+  }
+  rhBatchFlush();
+  rhBatching = false;
+}
+
+#if BAT_ENABLED == 1
+/**
+ * Get the battery charge in percent from the battery adc value.
+ */
+uint8_t batteryPercent () {
+  if (batteryRaw <= BAT_ADC_LOW) {
+    return 0;
+  } else if (batteryRaw >= BAT_ADC_FULL) {
+    return 100;
+  } else {
+    return 100 * (batteryRaw - BAT_ADC_LOW) / (BAT_ADC_FULL - BAT_ADC_LOW);
+  }
+}
+#endif
+
+/**
+ * Check if the message type is one of the pushed values, which have a lower
+ * priority than valve state changes and replies.
+ */
+bool rhIsPush (uint8_t msgType) {
+  return msgType == RH_MSG_TELEMETRY || msgType == RH_MSG_SENSOR_VALUES
+    || msgType == RH_MSG_BATTERY || msgType == RH_MSG_TEMP_SENSOR_DATA;
 }
 
 /**
- * Function to send a RadioHead message.
+ * Function to queue a RadioHead message for sending.
  * The data part of the message must be set in rhBufTx before calling this function.
- * @param  msgType   Type-code of this message. Will be set in rhBufTx[0].
- * @param  len       Length of the data including the type byte.
- * @param  sendTo    Target address to send the message to. Defaults to the configured server address.
- * @return           `true` if the message is successfully send.
+ * The message is copied into the transmit queue and send by the transmit task.
+ * While handling received messages, the replies are collected into one batch frame.
+ * @param  msgType        Type-code of this message. Will be set in rhBufTx[0].
+ * @param  len            Length of the data including the type byte.
+ * @param  sendTo         Target address to send the message to. Defaults to the configured server address.
+ * @param  delayAfterSend Time in milliseconds to pause the transmission after this message.
+ * @return                `true` if the message is queued, `false` if the queue is full.
  */
 bool rhSend(uint8_t msgType, uint8_t len, uint8_t sendTo, uint16_t delayAfterSend) {
   rhBufTx[0] = msgType;
-  if (!rhManager.sendtoWait(rhBufTx, len, sendTo)) {
-    blinkCode(BLINK_CODE_RH_SEND_ERROR);
-    return false;
+
+  if (rhBatching) {
+    // send the collected replies first if this one is for another sender or doesn't fit
+    if (rhBatchCount > 0 && (sendTo != rhBatchTo || rhBatchLen + 1 + len > RH_BUF_TX_LEN)) {
+      rhBatchFlush();
+    }
+    if (2 + len <= RH_BUF_TX_LEN) {
+      rhBatchBuf[rhBatchLen] = len;
+      memcpy(&rhBatchBuf[rhBatchLen + 1], rhBufTx, len);
+      rhBatchLen += 1 + len;
+      rhBatchCount++;
+      rhBatchTo = sendTo;
+      rhBatchDelay = delayAfterSend;
+      return true;
+    }
   }
-  if (delayAfterSend > 0) {
-    delay(delayAfterSend);
+
+  if (!rhBatching && rhIsPush(msgType)) {
+    // replace pushed values of the same type still waiting in the queue by the newer ones
+    for (uint8_t i = (rhTxState == RH_TX_IDLE) ? 0 : 1; i < rhTxQueueCount; i++) {
+      RhTxFrame *frame = &rhTxQueue[(rhTxQueueHead + i) % RH_TX_QUEUE_LEN];
+      #if RH_ROUTING == 1
+        if (frame->data[1] != settings.ownAddress) {
+          // relayed message of another node
+          continue;
+        }
+      #endif
+      if (frame->data[RH_ROUTE_HEADER_LEN] == msgType && frame->to == sendTo) {
+        memcpy(&frame->data[RH_ROUTE_HEADER_LEN], rhBufTx, len);
+        frame->len = RH_ROUTE_HEADER_LEN + len;
+        rhTxMerged++;
+        return true;
+      }
+    }
+  }
+
+  return rhQueue(rhBufTx, len, sendTo, delayAfterSend);
+}
+
+/**
+ * Get a random backoff time for the given try.
+ * The random range starts at the base time and is doubled with each try.
+ */
+unsigned long rhTxBackoff (uint16_t base, uint8_t tries) {
+  return random(0, (uint32_t)base << min(tries, RH_BACKOFF_MAX_EXP));
+}
+
+/**
+ * Hand the frame at the head of the queue to the driver.
+ * If the channel is in use by another node, the frame is put back for a
+ * random time instead.
+ */
+void rhTxTransmit (unsigned long now) {
+  RhTxFrame *frame = &rhTxQueue[rhTxQueueHead];
+
+  #if RH_ROUTING == 1
+    rhTxNextHop = rhRouteNextHop(frame->to);
+  #else
+    rhTxNextHop = frame->to;
+  #endif
+
+  #if RH_CARRIER_SENSE == 1
+    if (rhTxBusyTries < RH_CARRIER_SENSE_TRIES && rhDriver.isChannelActive()) {
+      // wait at least for one frame of the other node
+      rhTxBusy++;
+      rhTxState = RH_TX_BACKOFF;
+      schedulerSet(TASK_RH_SEND, now + RH_AIRTIME(RH_BUF_TX_LEN) + rhTxBackoff(RH_AIRTIME(RH_BUF_TX_LEN), rhTxBusyTries));
+      rhTxBusyTries++;
+      return;
+    }
+    rhTxBusyTries = 0;
+  #endif
+
+  rhManager.setHeaderId(rhTxId);
+  rhManager.setHeaderFlags(RH_FLAGS_NONE, RH_FLAGS_ACK); // clear the ack flag
+  rhManager.sendto(frame->data, frame->len, rhTxNextHop);
+  rhAirtimeAdd(frame->len);
+
+  rhTxTries++;
+  rhTxAcked = false;
+  rhListen(now);
+  rhTxState = RH_TX_SENDING;
+  schedulerSet(TASK_RH_SEND, now + RH_POLL_INTERVAL);
+}
+
+/**
+ * Remove the frame at the head of the queue and schedule the next one.
+ */
+void rhTxDone (unsigned long now) {
+  uint16_t delayAfterSend = rhTxQueue[rhTxQueueHead].delayAfterSend;
+
+  rhTxQueueHead = (rhTxQueueHead + 1) % RH_TX_QUEUE_LEN;
+  rhTxQueueCount--;
+  rhTxState = RH_TX_IDLE;
+  rhListen(now);
+
+  if (rhTxQueueCount > 0) {
+    schedulerSet(TASK_RH_SEND, now + delayAfterSend);
+  }
+}
+
+/**
+ * Task to advance the transmission of the queued frames.
+ * Does the same as RHReliableDatagram::sendtoWait() but without blocking.
+ */
+void taskRhSend (uint8_t task, unsigned long now) {
+  // wait until the driver is done with a running transmission
+  if (rhDriver.mode() == RHGenericDriver::RHModeTx) {
+    schedulerSet(TASK_RH_SEND, now + RH_POLL_INTERVAL);
+    return;
+  }
+
+  switch (rhTxState) {
+    case RH_TX_IDLE:
+      if (rhTxQueueCount == 0) {
+        return;
+      }
+      // new frame, use the next sequence number for all tries
+      rhTxId++;
+      rhTxTries = 0;
+      rhTxBusyTries = 0;
+      rhTxAcked = false;
+      rhTxTransmit(now);
+      break;
+
+    case RH_TX_BACKOFF:
+      // try again after the channel was in use, unless a late ack arrived meanwhile
+      if (rhTxAcked) {
+        rhTxSent++;
+        rhTxDone(now);
+      } else {
+        rhTxTransmit(now);
+      }
+      break;
+
+    case RH_TX_SENDING:
+      // the frame is send
+      if (rhTxAcked || rhTxNextHop == RH_BROADCAST_ADDRESS) {
+        // already acknowledged or broadcast which is not acknowledged
+        rhTxSent++;
+        rhTxDone(now);
+        break;
+      }
+      // wait for the ack with a random part like RHReliableDatagram does,
+      // but with a range doubled on each retry to resolve repeated collisions
+      rhTxState = RH_TX_WAIT_ACK;
+      schedulerSet(TASK_RH_SEND, now + RH_SEND_TIMEOUT + rhTxBackoff(RH_SEND_TIMEOUT, rhTxTries - 1));
+      break;
+
+    case RH_TX_WAIT_ACK:
+      if (rhTxAcked) {
+        rhTxSent++;
+        rhTxDone(now);
+      } else if (rhTxTries <= RH_SEND_RETRIES) {
+        // no ack in time, retry
+        rhTxRetries++;
+        rhTxTransmit(now);
+      } else {
+        // no ack after all retries
+        rhTxFailed++;
+        blinkCode(BLINK_CODE_RH_SEND_ERROR);
+        rhTxDone(now);
+      }
+      break;
   }
-  return true;
 }
 
 /**
@@ -288,27 +1061,30 @@ bool rhSendData(uint8_t msgType, bool forceSend, uint8_t sendTo, uint16_t delayA
       break;
 
     case RH_MSG_CHANNEL_STATE:
-      rhBufTx[1] = channelOn[0] ? 0x01 : 0x00;
-      rhBufTx[2] = channelOn[1] ? 0x01 : 0x00;
-      rhBufTx[3] = channelOn[2] ? 0x01 : 0x00;
-      rhBufTx[4] = channelOn[3] ? 0x01 : 0x00;
-      len = 5;
+      for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+        rhBufTx[1+chan] = (channelOn & CHANNEL_BIT(chan)) ? 0x01 : 0x00;
+      }
+      len = 1 + CHANNEL_COUNT;
       break;
 
     case RH_MSG_TEMP_SENSOR_DATA:
+      // [1] telemetry flags of the present values, [2] int16 temperature and [4] int16 humidity
+      // in hundredth of a degree or percent, [6] temperature switch state
+      // always 7 bytes, so it can't be mistaken for the float values of older versions (5, 6, 9 or 10 bytes)
       #if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
-        memcpy(&rhBufTx[1], &temperature, 4);
-        memcpy(&rhBufTx[5], &humidity, 4);
-        rhBufTx[9] = (tempSwitchOn) ? 0x01 : 0x00;
-        len = 10;
+        rhBufTx[1] = RH_TELEMETRY_TEMP | RH_TELEMETRY_HUMIDITY | RH_TELEMETRY_FIXED;
+        memcpy(&rhBufTx[4], &humidity, 2);
       #elif TEMP_SENSOR_TYPE == 1820
-        memcpy(&rhBufTx[1], &temperature, 4);
-        rhBufTx[5] = (tempSwitchOn) ? 0x01 : 0x00;
-        len = 6;
+        rhBufTx[1] = RH_TELEMETRY_TEMP | RH_TELEMETRY_FIXED;
+        rhBufTx[4] = 0x00;
+        rhBufTx[5] = 0x00;
       #else
         // nothing to do if no sensor is enabled
         return true;
       #endif
+      memcpy(&rhBufTx[2], &temperature, 2);
+      rhBufTx[6] = (tempSwitchOn) ? 0x01 : 0x00;
+      len = 7;
       break;
 
     case RH_MSG_SENSOR_VALUES:
@@ -317,8 +1093,8 @@ bool rhSendData(uint8_t msgType, bool forceSend, uint8_t sendTo, uint16_t delayA
         return true;
       }
 
-      for (uint8_t chan = 0; chan < 4; chan++) {
-        if (settings.channelEnabled[chan]) {
+      for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+        if (settings.channelEnabled & CHANNEL_BIT(chan)) {
           memcpy(&rhBufTx[1+chan*2], &adcValues[chan], 2);
         } else {
           // if channel is disabled but sending adc values is enabled set the value in buffer to 0x0000
@@ -326,19 +1102,58 @@ bool rhSendData(uint8_t msgType, bool forceSend, uint8_t sendTo, uint16_t delayA
           rhBufTx[2+chan*2] = 0x00;
         }
       }
-      len = 9;
+      len = 1 + CHANNEL_COUNT * 2;
+      break;
+
+    case RH_MSG_TELEMETRY:
+      {
+        // send all current values, the flags in rhBufTx[1] mark the present values
+        uint8_t flags = 0;
+        rhBufTx[2] = channelOn;
+        rhBufTx[3] = settings.channelEnabled;
+        len = 4;
+
+        // the adc values are not updated while paused
+        if (settings.sendAdcValuesThroughRH && !pauseAutomatic) {
+          flags |= RH_TELEMETRY_SENSORS;
+          for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+            uint16_t value = (settings.channelEnabled & CHANNEL_BIT(chan)) ? adcValues[chan] : 0;
+            memcpy(&rhBufTx[len], &value, 2);
+            len += 2;
+          }
+        }
+
+        #if BAT_ENABLED == 1
+          flags |= RH_TELEMETRY_BATTERY;
+          rhBufTx[len] = batteryPercent();
+          memcpy(&rhBufTx[len + 1], &batteryRaw, 2);
+          len += 3;
+        #endif
+
+        #if TEMP_SENSOR_TYPE != 0
+          flags |= RH_TELEMETRY_TEMP | RH_TELEMETRY_FIXED;
+          memcpy(&rhBufTx[len], &temperature, 2);
+          len += 2;
+          #if TEMP_SENSOR_TYPE == 11 || TEMP_SENSOR_TYPE == 12 || TEMP_SENSOR_TYPE == 22
+            flags |= RH_TELEMETRY_HUMIDITY;
+            memcpy(&rhBufTx[len], &humidity, 2);
+            len += 2;
+          #endif
+        #endif
+
+        if (tempSwitchOn) {
+          flags |= RH_TELEMETRY_TEMP_SWITCH;
+        }
+        if (pauseAutomatic) {
+          flags |= RH_TELEMETRY_PAUSED;
+        }
+        rhBufTx[1] = flags;
+      }
       break;
 
     case RH_MSG_BATTERY:
       #if BAT_ENABLED == 1
-        // calc battery percent value
-        if (batteryRaw <= BAT_ADC_LOW) {
-          rhBufTx[1] = 0;
-        } else if (batteryRaw >= BAT_ADC_FULL) {
-          rhBufTx[1] = 100;
-        } else {
-          rhBufTx[1] = 100 * (batteryRaw - BAT_ADC_LOW) / (BAT_ADC_FULL - BAT_ADC_LOW);
-        }
+        rhBufTx[1] = batteryPercent();
 
         // store battery raw value into buffer
         memcpy(&rhBufTx[2], &batteryRaw, 2);
@@ -354,8 +1169,117 @@ bool rhSendData(uint8_t msgType, bool forceSend, uint8_t sendTo, uint16_t delayA
         rhBufTx[1] = SOFTWARE_VERSION_MAJOR;
         rhBufTx[2] = SOFTWARE_VERSION_MINOR;
         rhBufTx[3] = SOFTWARE_VERSION_PATCH;
-        len = 4;
+        rhBufTx[4] = CHANNEL_COUNT;
+        len = 5;
         break;
+
+    case RH_MSG_TX_STATS:
+      // send the transmit statistics
+      rhBufTx[1] = rhTxQueueCount;
+      rhBufTx[2] = rhTxQueueMax;
+      memcpy(&rhBufTx[3], &rhTxSent, 2);
+      memcpy(&rhBufTx[5], &rhTxRetries, 2);
+      memcpy(&rhBufTx[7], &rhTxFailed, 2);
+      memcpy(&rhBufTx[9], &rhTxDropped, 2);
+      {
+        // airtime and duty cycle within the window in hundredth of a percent
+        uint32_t airtimeUsed = rhAirtimeUsed();
+        uint16_t dutyCycle = airtimeUsed * 10 / RH_DUTY_CYCLE_WINDOW;
+        memcpy(&rhBufTx[11], &rhAirtimeTotal, 4);
+        memcpy(&rhBufTx[15], &airtimeUsed, 4);
+        memcpy(&rhBufTx[19], &dutyCycle, 2);
+        memcpy(&rhBufTx[21], &rhTxDeferred, 2);
+        memcpy(&rhBufTx[23], &rhTxMerged, 2);
+      }
+      memcpy(&rhBufTx[25], &rhTxBusy, 2);
+      len = 27;
+      break;
+
+    case RH_MSG_POWER_STATS:
+      {
+        // send the power saving statistics
+        uint16_t dutyCycle = powersaveDutyCycle();
+        uint32_t uptime = millis() / 1000;
+        uint32_t sleepTime = powersaveSleepTime / 1000;
+        uint16_t checkInterval = samplingCheckInterval();
+        rhBufTx[1] = POWERSAVE_MODE;
+        memcpy(&rhBufTx[2], &dutyCycle, 2);
+        memcpy(&rhBufTx[4], &uptime, 4);
+        memcpy(&rhBufTx[8], &sleepTime, 4);
+        memcpy(&rhBufTx[12], &checkInterval, 2);
+        memcpy(&rhBufTx[14], &sensorsOnTime, 4);
+        len = 18;
+      }
+      break;
+
+    case RH_MSG_LOOP_STATS:
+      {
+        // send the loop pass statistics
+        uint16_t passAvg = loopPassAverage();
+        memcpy(&rhBufTx[1], &loopPassCount, 4);
+        memcpy(&rhBufTx[5], &loopPassMax, 4);
+        memcpy(&rhBufTx[9], &passAvg, 2);
+        rhBufTx[11] = loopStallSite;
+        memcpy(&rhBufTx[12], loopHistogram, LOOP_HISTOGRAM_LEN * 2);
+        len = 12 + LOOP_HISTOGRAM_LEN * 2;
+      }
+      break;
+
+    case RH_MSG_MEMORY_STATS:
+      {
+        // send the memory usage
+        MemoryStats stats;
+        memoryGetStats(&stats);
+        memcpy(&rhBufTx[1], &stats.ramSize, 2);
+        memcpy(&rhBufTx[3], &stats.staticRam, 2);
+        memcpy(&rhBufTx[5], &stats.heapUsed, 2);
+        memcpy(&rhBufTx[7], &stats.stackUsed, 2);
+        memcpy(&rhBufTx[9], &stats.stackMax, 2);
+        memcpy(&rhBufTx[11], &stats.free, 2);
+        memcpy(&rhBufTx[13], &stats.minFree, 2);
+        memcpy(&rhBufTx[15], &stats.flashUsed, 2);
+        len = 17;
+      }
+      break;
+
+    case RH_MSG_VALVE_QUEUE:
+      {
+        // send the open valves, the estimated time until the queue is done and the waiting channels in order
+        uint16_t remaining = valveQueueRemaining(millis());
+        rhBufTx[1] = channelOn;
+        memcpy(&rhBufTx[2], &remaining, 2);
+        rhBufTx[4] = valveQueueList(&rhBufTx[5]);
+        len = 5 + rhBufTx[4];
+      }
+      break;
+
+    case RH_MSG_SENSOR_STATS:
+      // send the channels settled within the warmup time and the settle time in milliseconds of each channel on the last check
+      rhBufTx[1] = sensorsSettled;
+      memcpy(&rhBufTx[2], sensorsSettleTime, CHANNEL_COUNT * 2);
+      len = 2 + CHANNEL_COUNT * 2;
+      break;
+
+    case RH_MSG_ROUTE_STATS:
+      // send if routed mode is enabled, the hops of the last message from the server,
+      // the number of relayed and dropped messages and the learned routes
+      #if RH_ROUTING == 1
+        rhBufTx[1] = 0x01;
+        rhBufTx[2] = rhRouteServerHops;
+        memcpy(&rhBufTx[3], &rhRouteForwarded, 2);
+        memcpy(&rhBufTx[5], &rhRouteDropped, 2);
+        rhBufTx[7] = rhRouteCount;
+        len = 8;
+        for (uint8_t i = 0; i < rhRouteCount; i++) {
+          rhBufTx[len++] = rhRoutes[i].dest;
+          rhBufTx[len++] = rhRoutes[i].nextHop;
+          rhBufTx[len++] = rhRoutes[i].hops;
+        }
+      #else
+        memset(&rhBufTx[1], 0, 7);
+        len = 8;
+      #endif
+      break;
   }
 
   // send the data
@@ -11,15 +11,33 @@
 #define RH_MSG_START            0x00
 #define RH_MSG_BATTERY          0x02
 #define RH_MSG_SENSOR_VALUES    0x10
+#define RH_MSG_TELEMETRY        0x11
+#define RH_MSG_BATCH            0x12
 #define RH_MSG_TEMP_SENSOR_DATA 0x20
 //#define RH_MSG_CHANNEL_ON     0x21 // < v2.0.0
 //#define RH_MSG_CHANNEL_OFF    0x22 // < v2.0.0
 #define RH_MSG_CHANNEL_STATE    0x25
+#define RH_MSG_TX_STATS         0x30
+#define RH_MSG_POWER_STATS      0x31
+#define RH_MSG_LOOP_STATS       0x32
+#define RH_MSG_MEMORY_STATS     0x33
+#define RH_MSG_HISTORY          0x34
+#define RH_MSG_VALVE_QUEUE      0x35
+#define RH_MSG_SENSOR_STATS     0x36
+#define RH_MSG_ROUTE_STATS      0x37
+#define RH_MSG_TASK_STATS       0x38
 
 #define RH_MSG_SETTINGS         0x50
 #define RH_MSG_GET_SETTINGS     0x51
 #define RH_MSG_SET_SETTINGS     0x52
 #define RH_MSG_SAVE_SETTINGS    0x53
+#define RH_MSG_EXT_SETTINGS     0x54
+#define RH_MSG_GET_EXT_SETTINGS 0x55
+#define RH_MSG_SET_EXT_SETTINGS 0x56
+#define RH_MSG_PATCH_SETTINGS   0x57
+#define RH_MSG_SETTINGS_PATCHED 0x58
+#define RH_MSG_CHANNEL_SETTINGS 0x59
+#define RH_MSG_GET_CHANNEL_SETTINGS 0x5A
 
 #define RH_MSG_CHECK_NOW        0x60
 //#define RH_MSG_TURN_CHANNEL_ON  0x61 // < v2.0.0
@@ -30,27 +48,175 @@
 #define RH_MSG_POLL_DATA        0x66
 #define RH_MSG_PAUSE_ON_OFF     0x67
 #define RH_MSG_TURN_TEMP_SWITCH_ON_OFF 0x68
+#define RH_MSG_GET_TX_STATS     0x69
+#define RH_MSG_GET_POWER_STATS  0x6A
+#define RH_MSG_GET_LOOP_STATS   0x6B
+#define RH_MSG_GET_MEMORY_STATS 0x6C
+#define RH_MSG_GET_HISTORY      0x6D
+#define RH_MSG_GET_VALVE_QUEUE  0x6E
+#define RH_MSG_GET_SENSOR_STATS 0x6F
+#define RH_MSG_GET_ROUTE_STATS  0x70
+#define RH_MSG_GET_TASK_STATS   0x71
 
 #define RH_MSG_GET_VERSION      0xF0
 #define RH_MSG_VERSION          0xF1
 #define RH_MSG_PING             0xF2
 #define RH_MSG_PONG             0xF3
 
+// properties of the driver
+// max message length, bitrate, bits on the air per byte and bytes of a frame around the message
+#if RH_DRIVER == 0
+  #define RH_DRIVER_MAX_MESSAGE_LEN RH_ASK_MAX_MESSAGE_LEN
+  #define RH_DRIVER_BITRATE         RH_SPEED
+  #define RH_DRIVER_BITS_PER_BYTE   12 // 4 to 6 bit encoding
+  #define RH_DRIVER_FRAME_OVERHEAD  13 // preamble, length, headers and crc
+#elif RH_DRIVER == 69
+  #define RH_DRIVER_MAX_MESSAGE_LEN RH_RF69_MAX_MESSAGE_LEN
+  #define RH_DRIVER_BITRATE         250000 // default modem config GFSK_Rb250Fd250
+  #define RH_DRIVER_BITS_PER_BYTE   8
+  #define RH_DRIVER_FRAME_OVERHEAD  13 // preamble, sync words, length, headers and crc
+#elif RH_DRIVER == 95
+  #define RH_DRIVER_MAX_MESSAGE_LEN RH_RF95_MAX_MESSAGE_LEN
+  #define RH_DRIVER_BITRATE         5470 // default modem config Bw125Cr45Sf128
+  #define RH_DRIVER_BITS_PER_BYTE   8
+  #define RH_DRIVER_FRAME_OVERHEAD  20 // preamble symbols, lora header, headers and crc
+#elif RH_DRIVER == 1
+  #define RH_DRIVER_MAX_MESSAGE_LEN RH_SERIAL_MAX_MESSAGE_LEN
+  #define RH_DRIVER_BITRATE         RH_SERIAL_SPEED
+  #define RH_DRIVER_BITS_PER_BYTE   10 // start and stop bit
+  #define RH_DRIVER_FRAME_OVERHEAD  10 // framing, headers and crc
+#else
+  #error RH_DRIVER must be 0, 69, 95 or 1!
+#endif
+
+// time in milliseconds to transmit a message with the given length
+#define RH_AIRTIME(len) (((uint32_t)(len) + RH_DRIVER_FRAME_OVERHEAD) * RH_DRIVER_BITS_PER_BYTE * 1000 / RH_DRIVER_BITRATE + 1)
+
+// duty cycle budget in milliseconds of airtime per window
+// the window is split into slots, the oldest slot is dropped as a whole
+#define RH_AIRTIME_SLOTS     6
+#define RH_AIRTIME_SLOT_TIME ((uint32_t)RH_DUTY_CYCLE_WINDOW * 1000 / RH_AIRTIME_SLOTS)
+#define RH_AIRTIME_BUDGET    ((uint32_t)RH_DUTY_CYCLE_WINDOW * RH_DUTY_CYCLE)
+#define RH_AIRTIME_PUSH_BUDGET (RH_AIRTIME_BUDGET * (100 - RH_DUTY_CYCLE_RESERVE) / 100)
+
+// timeout for an ack, which is the time to transmit the ack plus the time for the server
+#define RH_SEND_TIMEOUT (RH_AIRTIME(1) + RH_SEND_TIMEOUT_MARGIN)
+
+// header of routed messages like RHRouter::RoutedMessageHeader in front of the message
+// [0] destination, [1] source, [2] hops, [3] id, [4] flags
+#if RH_ROUTING == 1
+  #define RH_ROUTE_HEADER_LEN 5
+#else
+  #define RH_ROUTE_HEADER_LEN 0
+#endif
+#define RH_DRIVER_PAYLOAD_LEN (RH_DRIVER_MAX_MESSAGE_LEN - RH_ROUTE_HEADER_LEN)
+
 // buffer for RadioHead messages
 // rhBuf?x[0] - message type
-#define RH_BUF_TX_LEN 28
-#define RH_BUF_RX_LEN 28
+// the telemetry message needs more than 28 bytes with more than 6 channels
+#define RH_BUF_TELEMETRY_LEN (15 + CHANNEL_COUNT * 2)
+#define RH_BUF_TX_WANTED_LEN (RH_BUF_LEN > RH_BUF_TELEMETRY_LEN ? RH_BUF_LEN : RH_BUF_TELEMETRY_LEN)
+#define RH_BUF_TX_LEN (RH_BUF_TX_WANTED_LEN < RH_DRIVER_PAYLOAD_LEN ? RH_BUF_TX_WANTED_LEN : RH_DRIVER_PAYLOAD_LEN)
+#define RH_BUF_RX_LEN (RH_BUF_LEN < RH_DRIVER_PAYLOAD_LEN ? RH_BUF_LEN : RH_DRIVER_PAYLOAD_LEN)
+
+static_assert(RH_BUF_LEN >= 28, "RH_BUF_LEN must be at least 28 for the settings messages");
+static_assert(RH_BUF_TX_LEN >= RH_BUF_TELEMETRY_LEN && RH_BUF_RX_LEN >= 28, "the messages are too long for the driver");
+static_assert(RH_ROUTES * 3 + 8 <= RH_BUF_TX_LEN, "too many routes for the route stats message");
+
+// number of tasks in one task stats message, each with 4 bytes after the 3 byte header
+#define RH_TASK_STATS_PER_MSG ((RH_BUF_TX_LEN - 3) / 4)
+
+// number of channels in the settings messages, the others are only available as channel settings
+#define RH_SETTINGS_CHANNELS (CHANNEL_COUNT < 4 ? CHANNEL_COUNT : 4)
 extern uint8_t rhBufTx[RH_BUF_TX_LEN];
 extern uint8_t rhBufRx[RH_BUF_RX_LEN];
 
-// reduce the RadioHead max message length to save memory
-#define RH_ASK_MAX_MESSAGE_LEN RH_BUF_LEN
+// presence flags of the telemetry message
+// [1] flags, [2] mask of the channels on, [3] mask of the enabled channels, then the present values
+#define RH_TELEMETRY_SENSORS     0x01 // uint16 adc value of each channel
+#define RH_TELEMETRY_BATTERY     0x02 // uint8 percent and uint16 adc value
+#define RH_TELEMETRY_TEMP        0x04 // temperature, int16 hundredth of a degree if RH_TELEMETRY_FIXED, float otherwise
+#define RH_TELEMETRY_HUMIDITY    0x08 // humidity, int16 hundredth of a percent if RH_TELEMETRY_FIXED, float otherwise
+#define RH_TELEMETRY_TEMP_SWITCH 0x10 // temperature switch is on
+#define RH_TELEMETRY_PAUSED      0x20 // automatic watering is paused
+#define RH_TELEMETRY_FIXED       0x40 // temperature and humidity are fixed point values
+
+// rejected field of the settings patch ack if all fields are applied
+#define RH_SETTINGS_PATCH_OK 0xFF
 
 #define RH_FORCE_SEND true
 #define RH_SEND_ONLY_WHEN_PUSH_ENABLED false
 
+// states of the transmit task
+#define RH_TX_IDLE     0 // waiting for a frame in the queue
+#define RH_TX_SENDING  1 // frame handed to the driver, waiting until it is send
+#define RH_TX_WAIT_ACK 2 // waiting for the ack of the frame
+#define RH_TX_BACKOFF  3 // channel in use, waiting to send the frame
+
+// frame in the receive queue
+struct RhRxFrame {
+  uint8_t from;            // sender address
+  uint8_t len;             // length of the data including the type byte
+  uint8_t data[RH_ROUTE_HEADER_LEN + RH_BUF_RX_LEN]; // routed: header received in front of the message
+};
+
+// frame in the transmit queue
+struct RhTxFrame {
+  uint8_t to;              // target address
+  uint8_t len;             // length of the data including the type byte and the route header
+  uint16_t delayAfterSend; // time in milliseconds to pause after the frame
+  uint8_t data[RH_ROUTE_HEADER_LEN + RH_BUF_TX_LEN]; // routed: header in front of the message
+};
+
+// last message id of a sender
+struct RhRxSeen {
+  uint8_t from;            // address of the sender
+  uint8_t id;              // id of the last message
+};
+
+// learned route
+struct RhRoute {
+  uint8_t dest;            // destination address
+  uint8_t nextHop;         // address of the neighbour to send to
+  uint8_t hops;            // number of hops from the destination to this node
+};
+
+// transmit statistics
+extern uint8_t rhTxQueueCount;
+extern uint8_t rhTxQueueMax;
+extern uint16_t rhTxSent;
+extern uint16_t rhTxRetries;
+extern uint16_t rhTxFailed;
+extern uint16_t rhTxDropped;
+extern uint16_t rhTxDeferred;
+extern uint16_t rhTxMerged;
+extern uint16_t rhTxBusy;
+extern uint32_t rhAirtimeTotal;
+
+#if RH_ROUTING == 1
+  // route statistics
+  extern uint16_t rhRouteForwarded;
+  extern uint16_t rhRouteDropped;
+  extern uint8_t rhRouteServerHops;
+#endif
+
+#if POWERSAVE_MODE == 2
+  extern unsigned long rhListenUntil;
+#endif
+
+#if BAT_ENABLED == 1
+  uint8_t batteryPercent ();
+#endif
+
 void rhInit ();
 void rhRecv ();
+void rhListen (unsigned long now);
+void rhStopListening ();
+void taskRhSend (uint8_t task, unsigned long now);
+uint8_t rhTxQueueUsed ();
+uint32_t rhAirtimeUsed ();
+bool rhAirtimeLow ();
+unsigned long rhAirtimeFreeAt ();
 bool rhSend(uint8_t msgType, uint8_t len, uint8_t sendTo = settings.serverAddress, uint16_t delayAfterSend = settings.delayAfterSend);
 bool rhSendData(uint8_t msgType, bool forceSend = RH_SEND_ONLY_WHEN_PUSH_ENABLED, uint8_t sendTo = settings.serverAddress, uint16_t delayAfterSend = settings.delayAfterSend);
 
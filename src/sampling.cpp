@@ -0,0 +1,175 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Filtering of the sensor adc values and the adaptive check interval.
+ *
+ * In adaptive mode the check interval is shortened if an adc value is near
+ * its trigger value or rises fast enough to reach it within two intervals,
+ * and right after a watering. Otherwise it grows by doubling up to the max
+ * interval.
+ */
+
+#include "sampling.h"
+
+// history of the last oversampled values of each channel
+uint16_t adcHistory[CHANNEL_COUNT][ADC_HISTORY_LEN];
+uint8_t adcHistoryPos[CHANNEL_COUNT];
+uint8_t adcHistoryCount[CHANNEL_COUNT];
+
+// state of the ewma filter in 1/64 adc steps
+uint16_t adcEwma[CHANNEL_COUNT];
+
+// current adaptive check interval in seconds
+uint16_t checkIntervalAdaptive = 0;
+// filtered values and time of the last adaptive check
+uint16_t checkLastValues[CHANNEL_COUNT];
+unsigned long checkLastTime;
+// channels with a valid last value
+ChannelMask checkLastValid = 0;
+// number of remaining checks with the min interval after a watering
+uint8_t checkFastCount = 0;
+
+/**
+ * Get the median of the last values in the history of a channel.
+ */
+uint16_t samplingMedian (uint8_t chan, uint8_t depth) {
+  uint16_t sorted[ADC_HISTORY_LEN];
+
+  // copy the last values into the array sorted by insertion sort
+  uint8_t pos = adcHistoryPos[chan];
+  for (uint8_t i = 0; i < depth; i++) {
+    pos = (pos == 0) ? ADC_HISTORY_LEN - 1 : pos - 1;
+    uint16_t value = adcHistory[chan][pos];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+
+  return sorted[depth / 2];
+}
+
+/**
+ * Add a value to the history of a channel and get the filtered value.
+ * The type and depth of the filter is set by settings.adcFilterType and
+ * settings.adcFilterDepth.
+ */
+uint16_t samplingFilter (uint8_t chan, uint16_t value) {
+  // add the value to the history
+  adcHistory[chan][adcHistoryPos[chan]] = value;
+  adcHistoryPos[chan] = (adcHistoryPos[chan] + 1) % ADC_HISTORY_LEN;
+  if (adcHistoryCount[chan] < ADC_HISTORY_LEN) {
+    adcHistoryCount[chan]++;
+  }
+
+  switch (settings.adcFilterType) {
+    case ADC_FILTER_MEDIAN:
+      return samplingMedian(chan, constrain(settings.adcFilterDepth, 1, adcHistoryCount[chan]));
+
+    case ADC_FILTER_EWMA:
+      if (adcHistoryCount[chan] == 1 || settings.adcFilterDepth <= 1) {
+        // first value or no weighting
+        adcEwma[chan] = value << 6;
+      } else {
+        // new = old + (value - old) / depth
+        adcEwma[chan] = adcEwma[chan] + (((int32_t)(value << 6) - adcEwma[chan]) / settings.adcFilterDepth);
+      }
+      return (adcEwma[chan] + 32) >> 6;
+
+    default:
+      return value;
+  }
+}
+
+/**
+ * Reset the history of a channel.
+ * Used after watering to not trigger again by the old values.
+ */
+void samplingReset (uint8_t chan) {
+  adcHistoryPos[chan] = 0;
+  adcHistoryCount[chan] = 0;
+
+  // check more often until the water arrived at the sensor
+  checkLastValid &= ~CHANNEL_BIT(chan);
+  checkFastCount = CHECK_ADAPTIVE_FAST;
+}
+
+/**
+ * Get the current check interval in seconds.
+ */
+uint16_t samplingCheckInterval () {
+  if (!settings.checkAdaptive) {
+    return settings.checkInterval;
+  }
+  uint16_t low = max(settings.checkIntervalMin, CHECK_INTERVAL_LOWEST);
+  return constrain(checkIntervalAdaptive, low, max(settings.checkIntervalMax, low));
+}
+
+/**
+ * Adapt the check interval to the filtered adc values of the last check.
+ * Must be called after each check.
+ * @return `true` if the check interval changed.
+ */
+bool samplingAdapt (unsigned long now) {
+  if (!settings.checkAdaptive) {
+    return false;
+  }
+
+  uint16_t low = max(settings.checkIntervalMin, CHECK_INTERVAL_LOWEST);
+  uint16_t high = max(settings.checkIntervalMax, low);
+  uint32_t elapsed = (now - checkLastTime) / 1000;
+  uint32_t interval = high;
+
+  ChannelMask valid = 0;
+  if (!pauseAutomatic) {
+    for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+      if (!(settings.channelEnabled & CHANNEL_BIT(chan))) continue;
+
+      // use the latest unfiltered value, since the filters delay a fast rise
+      uint16_t value = adcValues[chan];
+      if (adcHistoryCount[chan] > 0) {
+        value = adcHistory[chan][(adcHistoryPos[chan] + ADC_HISTORY_LEN - 1) % ADC_HISTORY_LEN];
+      }
+      uint16_t trigger = settings.adcTriggerValue[chan];
+      uint32_t limit = high;
+
+      if (value >= trigger) {
+        limit = low;
+      } else {
+        uint16_t dist = trigger - value;
+
+        // shorten the interval near the trigger value
+        if (dist < CHECK_ADAPTIVE_RANGE) {
+          limit = low + (uint32_t)(high - low) * dist / CHECK_ADAPTIVE_RANGE;
+        }
+
+        // check at least twice before the trigger value is reached at the current rate
+        if ((checkLastValid & CHANNEL_BIT(chan)) && value > checkLastValues[chan] && elapsed > 0) {
+          limit = min(limit, (uint32_t)dist * elapsed / (value - checkLastValues[chan]) / 2);
+        }
+      }
+
+      interval = min(interval, limit);
+      checkLastValues[chan] = value;
+      valid |= CHANNEL_BIT(chan);
+    }
+  }
+  checkLastValid = valid;
+  checkLastTime = now;
+
+  if (checkFastCount > 0) {
+    checkFastCount--;
+    interval = low;
+  }
+
+  // grow slowly, so a single calm check doesn't jump to the max interval
+  uint16_t current = samplingCheckInterval();
+  interval = constrain(interval, low, min((uint32_t)current * 2, (uint32_t)high));
+
+  checkIntervalAdaptive = interval;
+  return interval != current;
+}
@@ -0,0 +1,27 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __SAMPLING_H__
+#define __SAMPLING_H__
+
+#include "globals.h"
+
+// types of the filter for the adc values
+#define ADC_FILTER_NONE   0
+#define ADC_FILTER_MEDIAN 1
+#define ADC_FILTER_EWMA   2
+
+// max number of adc readings per channel and check
+#define ADC_OVERSAMPLING_MAX 16
+
+// shortest possible check interval in seconds
+#define CHECK_INTERVAL_LOWEST 10
+
+uint16_t samplingFilter (uint8_t chan, uint16_t value);
+void samplingReset (uint8_t chan);
+uint16_t samplingCheckInterval ();
+bool samplingAdapt (unsigned long now);
+
+#endif
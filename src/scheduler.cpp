@@ -0,0 +1,156 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Tiny cooperative scheduler for the time-based events.
+ *
+ * The tasks are kept in a list ordered by their deadline, so the main loop
+ * only needs to look at the head of the list to know if something is due
+ * and how long it may idle until the next event.
+ */
+
+#include "scheduler.h"
+
+static_assert(SCHEDULER_TASK_COUNT <= 32, "the scheduler supports max 32 tasks");
+
+uint16_t schedulerMaxLateness[SCHEDULER_TASK_COUNT];
+uint16_t schedulerMaxRunTime[SCHEDULER_TASK_COUNT];
+
+SchedulerCallback schedulerCallbacks[SCHEDULER_TASK_COUNT];
+unsigned long schedulerTimes[SCHEDULER_TASK_COUNT];
+uint8_t schedulerNext[SCHEDULER_TASK_COUNT];
+uint8_t schedulerHead = SCHEDULER_END;
+
+/**
+ * Register the callback of a task.
+ * Must be called once for each task before using any other scheduler function on it.
+ * The task is not scheduled until schedulerSet() is called.
+ */
+void schedulerAdd (uint8_t task, SchedulerCallback callback) {
+  schedulerCallbacks[task] = callback;
+  schedulerNext[task] = SCHEDULER_IDLE;
+}
+
+/**
+ * Remove a task from the list of scheduled tasks.
+ * Nothing happens if the task is not scheduled.
+ */
+void schedulerCancel (uint8_t task) {
+  if (schedulerNext[task] == SCHEDULER_IDLE) {
+    return;
+  }
+
+  if (schedulerHead == task) {
+    schedulerHead = schedulerNext[task];
+  } else {
+    for (uint8_t i = schedulerHead; i != SCHEDULER_END; i = schedulerNext[i]) {
+      if (schedulerNext[i] == task) {
+        schedulerNext[i] = schedulerNext[task];
+        break;
+      }
+    }
+  }
+
+  schedulerNext[task] = SCHEDULER_IDLE;
+}
+
+/**
+ * Schedule a task to run at the given time.
+ * An already scheduled task will be moved to the new time.
+ * Tasks with the same time will run in the order they are scheduled.
+ */
+void schedulerSet (uint8_t task, unsigned long time) {
+  schedulerCancel(task);
+  schedulerTimes[task] = time;
+
+  // find the insert position, after all tasks which are due before or at the same time
+  uint8_t prev = SCHEDULER_END;
+  uint8_t cur = schedulerHead;
+  while (cur != SCHEDULER_END && checkTime(time, schedulerTimes[cur])) {
+    prev = cur;
+    cur = schedulerNext[cur];
+  }
+
+  schedulerNext[task] = cur;
+  if (prev == SCHEDULER_END) {
+    schedulerHead = task;
+  } else {
+    schedulerNext[prev] = task;
+  }
+}
+
+/**
+ * Check if the task is currently scheduled.
+ */
+bool schedulerIsSet (uint8_t task) {
+  return schedulerNext[task] != SCHEDULER_IDLE;
+}
+
+/**
+ * Get the time when the task is scheduled to run.
+ */
+unsigned long schedulerGetTime (uint8_t task) {
+  return schedulerTimes[task];
+}
+
+/**
+ * Run all tasks which are due at the given time.
+ * Each task runs at most once per call, so a task rescheduling itself
+ * into the past can't lock up the main loop.
+ * @return The id of the task with the longest run time or SCHEDULER_END if no task was run.
+ */
+uint8_t schedulerRun (unsigned long now) {
+  uint8_t slowestTask = SCHEDULER_END;
+  unsigned long slowestTime = 0;
+  // bitmask of the tasks which have run in this call
+  uint32_t ran = 0;
+
+  for (uint8_t n = 0; n < SCHEDULER_TASK_COUNT; n++) {
+    uint8_t task = schedulerHead;
+    if (task == SCHEDULER_END || !checkTime(now, schedulerTimes[task]) || (ran & ((uint32_t)1 << task))) {
+      break;
+    }
+    ran |= (uint32_t)1 << task;
+
+    // remove the task from the list before running it to allow the task to reschedule itself
+    schedulerHead = schedulerNext[task];
+    schedulerNext[task] = SCHEDULER_IDLE;
+
+    // track the lateness of the task
+    unsigned long lateness = now - schedulerTimes[task];
+    if (lateness > schedulerMaxLateness[task]) {
+      schedulerMaxLateness[task] = (lateness > 0xFFFF) ? 0xFFFF : lateness;
+    }
+
+    unsigned long start = micros();
+    schedulerCallbacks[task](task, now);
+
+    // track the run time of the task
+    unsigned long runTime = micros() - start;
+    if (slowestTask == SCHEDULER_END || runTime > slowestTime) {
+      slowestTask = task;
+      slowestTime = runTime;
+    }
+    runTime /= 1000;
+    if (runTime > schedulerMaxRunTime[task]) {
+      schedulerMaxRunTime[task] = (runTime > 0xFFFF) ? 0xFFFF : runTime;
+    }
+  }
+
+  return slowestTask;
+}
+
+/**
+ * Get the time in milliseconds until the next task is due.
+ * Returns 0 if a task is already due and 0xFFFFFFFF if no task is scheduled.
+ */
+unsigned long schedulerIdleTime (unsigned long now) {
+  if (schedulerHead == SCHEDULER_END) {
+    return 0xFFFFFFFF;
+  }
+  if (checkTime(now, schedulerTimes[schedulerHead])) {
+    return 0;
+  }
+  return schedulerTimes[schedulerHead] - now;
+}
@@ -0,0 +1,50 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include "globals.h"
+
+// ids of the scheduled tasks
+#define TASK_TEMP_SENSOR   0
+#define TASK_SENSORS_ON    1
+#define TASK_ADC_READ      2
+#define TASK_RH_POLL       3
+#define TASK_LED           4
+#define TASK_TEMP_SENSOR_READ 5
+#define TASK_RH_SEND       6
+#define TASK_HEARTBEAT     7
+#define TASK_VALVE_QUEUE   8
+#define TASK_SENSORS_SETTLE 9
+#define TASK_VALVE_OFF_0   10 // CHANNEL_COUNT tasks, one for each channel
+#define SCHEDULER_TASK_COUNT (TASK_VALVE_OFF_0 + CHANNEL_COUNT)
+
+// marker for the end of the task list
+#define SCHEDULER_END  0xFF
+// marker for a task which is currently not scheduled
+#define SCHEDULER_IDLE 0xFE
+
+/**
+ * Callback of a scheduled task.
+ * @param task The id of the task.
+ * @param now  The current time in milliseconds.
+ */
+typedef void (*SchedulerCallback)(uint8_t task, unsigned long now);
+
+// max lateness of each task in milliseconds (time between deadline and execution)
+extern uint16_t schedulerMaxLateness[SCHEDULER_TASK_COUNT];
+// max run time of each task in milliseconds
+extern uint16_t schedulerMaxRunTime[SCHEDULER_TASK_COUNT];
+
+void schedulerAdd (uint8_t task, SchedulerCallback callback);
+void schedulerSet (uint8_t task, unsigned long time);
+void schedulerCancel (uint8_t task);
+bool schedulerIsSet (uint8_t task);
+unsigned long schedulerGetTime (uint8_t task);
+uint8_t schedulerRun (unsigned long now);
+unsigned long schedulerIdleTime (unsigned long now);
+
+#endif
@@ -4,19 +4,49 @@
  * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
  *
  * Settings and setting-handlers for the options which can be changed at runtime.
+ *
+ * The settings are stored in SETTINGS_SLOTS slots in the eeprom, which are
+ * used in rotation to spread the writes. Each slot has a sequence number and
+ * a crc, so at startup the newest valid slot is used and an interrupted write
+ * falls back to the slot saved before.
  */
 
 #include "settings.h"
 
-#include <EEPROM.h>
+#include "valves.h"
+
+// slot and sequence number of the current settings in the eeprom
+uint8_t settingsSlot = SETTINGS_SLOTS - 1;
+uint8_t settingsSeq = 0;
+// if the current settings slot is valid
+bool settingsSlotValid = false;
+
+/**
+ * Get the eeprom address of a settings slot.
+ */
+uint16_t settingsSlotAddr (uint8_t slot) {
+  return EEPROM_ADDR_SETTINGS + slot * sizeof(SettingsSlot);
+}
+
+/**
+ * Calculate the crc of a settings slot in the eeprom.
+ */
+uint16_t settingsSlotCrc (uint8_t slot) {
+  uint16_t addr = settingsSlotAddr(slot);
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < offsetof(SettingsSlot, crc); i++) {
+    crc = _crc16_update(crc, EEPROM.read(addr + i));
+  }
+  return crc;
+}
 
 /**
  * Load the default settings.
  */
 void loadDefaultSettings () {
   // set default values
-  for (uint8_t chan = 0; chan < 4; chan++) {
-    settings.channelEnabled[chan] = (chan == 0); // only channel 0 is active
+  settings.channelEnabled = CHANNEL_BIT(0); // only channel 0 is active
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
     settings.adcTriggerValue[chan] = 512; // adc trigger value
     settings.wateringTime[chan] = 5; // opening time in seconds
   }
@@ -30,31 +60,271 @@ void loadDefaultSettings () {
   settings.tempSwitchTriggerValue = 30; // turn on temperature switch if > 30°C
   settings.tempSwitchHystTenth = 20; // 2°C hysteresis -> 32°C on, 28°C off
   settings.tempSwitchInverted = false; // don't invert - turn on if greater
+  settings.adcOversampling = 4; // average of 4 adc readings per check
+  settings.adcFilterType = 0; // no filter, so the watering starts on the first check above the trigger value
+  settings.adcFilterDepth = 3; // median of the last 3 checks
+  settings.pushOnChange = false; // push the values after each check
+  settings.deadbandAdc = 10; // push on adc value changes by more than 10
+  settings.deadbandTempTenth = 5; // push on temperature changes by more than 0.5°C
+  settings.deadbandBattery = 2; // push on battery changes by more than 2 %
+  settings.heartbeatInterval = 3600; // push at least once per hour
+  settings.valveMax = 1; // only one valve at the same time
+  settings.valveGap = 0; // open the next valve directly
+  settings.valveOrder = VALVE_ORDER_FIFO; // in the order of the requests
+  settings.checkAdaptive = false; // use the fixed check interval
+  settings.checkIntervalMin = 60; // adaptive check at least every minute near the trigger value
+  settings.checkIntervalMax = 1800; // adaptive check at least every 30 minutes
+  settings.sensorsWarmup = 1000; // turn on the sensors up to 1 second before reading
+  settings.settleTolerance = 3; // read as soon as two readings differ by 3 or less
+  settings.routeVia = RH_BROADCAST_ADDRESS; // send directly to the server in routed mode
 
   calcTempSwitchTriggerValues();
 }
 
 /**
- * Load the stored settings from the eeprom.
+ * Load the stored settings from the newest valid slot in the eeprom.
+ * @return `false` if there is no valid slot.
  */
-void loadSettings () {
-  EEPROM.get(EEPROM_ADDR_SETTINGS, settings);
+bool loadSettings () {
+  // find the valid slot with the highest sequence number
+  settingsSlotValid = false;
+  for (uint8_t slot = 0; slot < SETTINGS_SLOTS; slot++) {
+    uint16_t addr = settingsSlotAddr(slot);
+    uint16_t crc;
+    EEPROM.get(addr + offsetof(SettingsSlot, crc), crc);
+    if (crc != settingsSlotCrc(slot)) {
+      continue;
+    }
+
+    uint8_t seq = EEPROM.read(addr + offsetof(SettingsSlot, seq));
+    if (!settingsSlotValid || (int8_t)(seq - settingsSeq) > 0) {
+      settingsSlot = slot;
+      settingsSeq = seq;
+      settingsSlotValid = true;
+    }
+  }
+
+  if (!settingsSlotValid) {
+    return false;
+  }
+
+  EEPROM.get(settingsSlotAddr(settingsSlot) + offsetof(SettingsSlot, settings), settings);
 
   calcTempSwitchTriggerValues();
+  return true;
 }
 
 /**
- * Save the current settings into the eeporm.
+ * Save the current settings into the next slot in the eeprom.
+ * Nothing is written if the settings are unchanged and only the changed
+ * bytes of the slot are written.
  */
 void saveSettings () {
-  // write to eeprom
-  EEPROM.put(EEPROM_ADDR_SETTINGS, settings);
+  // check if the settings are changed
+  if (settingsSlotValid) {
+    uint16_t addr = settingsSlotAddr(settingsSlot) + offsetof(SettingsSlot, settings);
+    const uint8_t *data = (const uint8_t *)&settings;
+    uint8_t i = 0;
+    while (i < sizeof(Settings) && EEPROM.read(addr + i) == data[i]) {
+      i++;
+    }
+    if (i == sizeof(Settings)) {
+      return;
+    }
+  }
+
+  settingsSlot = (settingsSlot + 1) % SETTINGS_SLOTS;
+  settingsSeq++;
+
+  // write the data first, so the slot is invalid until the crc is written
+  uint16_t addr = settingsSlotAddr(settingsSlot);
+  EEPROM.update(addr + offsetof(SettingsSlot, seq), settingsSeq);
+  EEPROM.put(addr + offsetof(SettingsSlot, settings), settings);
+  EEPROM.put(addr + offsetof(SettingsSlot, crc), settingsSlotCrc(settingsSlot));
+  settingsSlotValid = true;
+}
+
+/**
+ * Invalidate all settings slots in the eeprom.
+ * Used if the data model of the eeprom changed.
+ */
+void clearSettings () {
+  for (uint8_t slot = 0; slot < SETTINGS_SLOTS; slot++) {
+    uint16_t addr = settingsSlotAddr(slot);
+    uint16_t crc = settingsSlotCrc(slot);
+    uint16_t storedCrc;
+    EEPROM.get(addr + offsetof(SettingsSlot, crc), storedCrc);
+    if (storedCrc == crc) {
+      EEPROM.put(addr + offsetof(SettingsSlot, crc), (uint16_t)(crc ^ 0xFFFF));
+    }
+  }
+
+  settingsSlot = SETTINGS_SLOTS - 1;
+  settingsSeq = 0;
+  settingsSlotValid = false;
+}
+
+/**
+ * Set a single field of the settings from a settings patch.
+ * @param field   Id of the field (SETTING_*).
+ * @param value   Little endian value of the field.
+ * @param len     Number of bytes available at value.
+ * @param affects Gets the SETTINGS_AFFECTS_* flags added if the value changed.
+ * @return The size of the value or 0 if the field is unknown or the value is incomplete.
+ */
+uint8_t patchSetting (uint8_t field, const uint8_t *value, uint8_t len, uint8_t *affects) {
+  void *ptr;
+  uint8_t size = 1;
+  bool isBool = false;
+  uint8_t affect = 0;
+
+  if (field >= SETTING_ADC_TRIGGER_VALUE && field < SETTING_ADC_TRIGGER_VALUE + CHANNEL_COUNT) {
+    ptr = &settings.adcTriggerValue[field - SETTING_ADC_TRIGGER_VALUE];
+    size = 2;
+  } else if (field >= SETTING_WATERING_TIME && field < SETTING_WATERING_TIME + CHANNEL_COUNT) {
+    ptr = &settings.wateringTime[field - SETTING_WATERING_TIME];
+    size = 2;
+  } else {
+    switch (field) {
+      case SETTING_CHANNEL_ENABLED:
+        ptr = &settings.channelEnabled;
+        break;
+      case SETTING_CHECK_INTERVAL:
+        ptr = &settings.checkInterval;
+        size = 2;
+        affect = SETTINGS_AFFECTS_ADC_READ;
+        break;
+      case SETTING_TEMP_SENSOR_INTERVAL:
+        ptr = &settings.tempSensorInterval;
+        size = 2;
+        affect = SETTINGS_AFFECTS_TEMP_SENSOR;
+        break;
+      case SETTING_SEND_ADC_VALUES:
+        ptr = &settings.sendAdcValuesThroughRH;
+        isBool = true;
+        break;
+      case SETTING_PUSH_DATA_ENABLED:
+        ptr = &settings.pushDataEnabled;
+        isBool = true;
+        break;
+      case SETTING_SERVER_ADDRESS:
+        ptr = &settings.serverAddress;
+        break;
+      case SETTING_OWN_ADDRESS:
+        ptr = &settings.ownAddress;
+        affect = SETTINGS_AFFECTS_OWN_ADDRESS;
+        break;
+      case SETTING_DELAY_AFTER_SEND:
+        ptr = &settings.delayAfterSend;
+        size = 2;
+        break;
+      case SETTING_TEMP_SWITCH_TRIGGER:
+        ptr = &settings.tempSwitchTriggerValue;
+        affect = SETTINGS_AFFECTS_TEMP_SWITCH;
+        break;
+      case SETTING_TEMP_SWITCH_HYST:
+        ptr = &settings.tempSwitchHystTenth;
+        affect = SETTINGS_AFFECTS_TEMP_SWITCH;
+        break;
+      case SETTING_TEMP_SWITCH_INVERTED:
+        ptr = &settings.tempSwitchInverted;
+        isBool = true;
+        break;
+      case SETTING_ADC_OVERSAMPLING:
+        ptr = &settings.adcOversampling;
+        break;
+      case SETTING_ADC_FILTER_TYPE:
+        ptr = &settings.adcFilterType;
+        break;
+      case SETTING_ADC_FILTER_DEPTH:
+        ptr = &settings.adcFilterDepth;
+        break;
+      case SETTING_PUSH_ON_CHANGE:
+        ptr = &settings.pushOnChange;
+        isBool = true;
+        affect = SETTINGS_AFFECTS_HEARTBEAT;
+        break;
+      case SETTING_DEADBAND_ADC:
+        ptr = &settings.deadbandAdc;
+        break;
+      case SETTING_DEADBAND_TEMP:
+        ptr = &settings.deadbandTempTenth;
+        break;
+      case SETTING_DEADBAND_BATTERY:
+        ptr = &settings.deadbandBattery;
+        break;
+      case SETTING_HEARTBEAT_INTERVAL:
+        ptr = &settings.heartbeatInterval;
+        size = 2;
+        affect = SETTINGS_AFFECTS_HEARTBEAT;
+        break;
+      case SETTING_VALVE_MAX:
+        ptr = &settings.valveMax;
+        affect = SETTINGS_AFFECTS_VALVE_QUEUE;
+        break;
+      case SETTING_VALVE_GAP:
+        ptr = &settings.valveGap;
+        size = 2;
+        break;
+      case SETTING_VALVE_ORDER:
+        ptr = &settings.valveOrder;
+        break;
+      case SETTING_CHECK_ADAPTIVE:
+        ptr = &settings.checkAdaptive;
+        isBool = true;
+        affect = SETTINGS_AFFECTS_ADC_READ;
+        break;
+      case SETTING_CHECK_INTERVAL_MIN:
+        ptr = &settings.checkIntervalMin;
+        size = 2;
+        affect = SETTINGS_AFFECTS_ADC_READ;
+        break;
+      case SETTING_CHECK_INTERVAL_MAX:
+        ptr = &settings.checkIntervalMax;
+        size = 2;
+        affect = SETTINGS_AFFECTS_ADC_READ;
+        break;
+      case SETTING_SENSORS_WARMUP:
+        ptr = &settings.sensorsWarmup;
+        size = 2;
+        affect = SETTINGS_AFFECTS_ADC_READ;
+        break;
+      case SETTING_SETTLE_TOLERANCE:
+        ptr = &settings.settleTolerance;
+        break;
+      case SETTING_ROUTE_VIA:
+        ptr = &settings.routeVia;
+        break;
+      default:
+        return 0;
+    }
+  }
+
+  if (len < size) {
+    return 0;
+  }
+
+  uint8_t newValue[2];
+  memcpy(newValue, value, size);
+  if (isBool) {
+    newValue[0] = (newValue[0] != 0);
+  } else if (field == SETTING_CHANNEL_ENABLED) {
+    newValue[0] &= CHANNEL_MASK_ALL;
+  }
+
+  // only changed values need an update of the timers
+  if (memcmp(ptr, newValue, size) != 0) {
+    memcpy(ptr, newValue, size);
+    *affects |= affect;
+  }
+
+  return size;
 }
 
 /**
- * Calculate temperature switch high/low trigger values.
+ * Calculate temperature switch high/low trigger values in hundredth of a degree.
  */
 void calcTempSwitchTriggerValues () {
-  tempSwitchTriggerValueHigh = settings.tempSwitchTriggerValue + (float)settings.tempSwitchHystTenth/10;
-  tempSwitchTriggerValueLow = settings.tempSwitchTriggerValue - (float)settings.tempSwitchHystTenth/10;
+  tempSwitchTriggerValueHigh = settings.tempSwitchTriggerValue * 100 + settings.tempSwitchHystTenth * 10;
+  tempSwitchTriggerValueLow = settings.tempSwitchTriggerValue * 100 - settings.tempSwitchHystTenth * 10;
 }
@@ -8,9 +8,52 @@
 
 #include "globals.h"
 
+// ids of the fields in a settings patch message, the values are little endian
+#define SETTING_CHANNEL_ENABLED      0x00 // ChannelMask
+#define SETTING_CHECK_INTERVAL       0x01 // uint16
+#define SETTING_TEMP_SENSOR_INTERVAL 0x02 // uint16
+#define SETTING_SEND_ADC_VALUES      0x03 // bool
+#define SETTING_PUSH_DATA_ENABLED    0x04 // bool
+#define SETTING_SERVER_ADDRESS       0x05 // uint8
+#define SETTING_OWN_ADDRESS          0x06 // uint8
+#define SETTING_DELAY_AFTER_SEND     0x07 // uint16
+#define SETTING_TEMP_SWITCH_TRIGGER  0x08 // int8
+#define SETTING_TEMP_SWITCH_HYST     0x09 // uint8 tenth
+#define SETTING_TEMP_SWITCH_INVERTED 0x0A // bool
+// the fields 0x0B to 0x1B are also the values of the extended settings message in this order
+#define SETTING_ADC_OVERSAMPLING     0x0B // uint8
+#define SETTING_ADC_FILTER_TYPE      0x0C // uint8
+#define SETTING_ADC_FILTER_DEPTH     0x0D // uint8
+#define SETTING_PUSH_ON_CHANGE       0x0E // bool
+#define SETTING_DEADBAND_ADC         0x0F // uint8
+#define SETTING_DEADBAND_TEMP        0x10 // uint8 tenth
+#define SETTING_DEADBAND_BATTERY     0x11 // uint8
+#define SETTING_HEARTBEAT_INTERVAL   0x12 // uint16
+#define SETTING_VALVE_MAX            0x13 // uint8
+#define SETTING_VALVE_GAP            0x14 // uint16
+#define SETTING_VALVE_ORDER          0x15 // uint8
+#define SETTING_CHECK_ADAPTIVE       0x16 // bool
+#define SETTING_CHECK_INTERVAL_MIN   0x17 // uint16
+#define SETTING_CHECK_INTERVAL_MAX   0x18 // uint16
+#define SETTING_SENSORS_WARMUP       0x19 // uint16
+#define SETTING_SETTLE_TOLERANCE     0x1A // uint8
+#define SETTING_ROUTE_VIA            0x1B // uint8
+#define SETTING_ADC_TRIGGER_VALUE    0x20 // +chan, uint16
+#define SETTING_WATERING_TIME        0x28 // +chan, uint16
+
+// things to update after a settings patch
+#define SETTINGS_AFFECTS_ADC_READ    0x01 // check interval changed
+#define SETTINGS_AFFECTS_TEMP_SENSOR 0x02 // temperature sensor interval changed
+#define SETTINGS_AFFECTS_TEMP_SWITCH 0x04 // temperature switch trigger values changed
+#define SETTINGS_AFFECTS_OWN_ADDRESS 0x08 // own address changed
+#define SETTINGS_AFFECTS_HEARTBEAT   0x10 // push on change or heartbeat changed
+#define SETTINGS_AFFECTS_VALVE_QUEUE 0x20 // max number of open valves changed
+
 void loadDefaultSettings ();
-void loadSettings ();
+bool loadSettings ();
 void saveSettings ();
+void clearSettings ();
+uint8_t patchSetting (uint8_t field, const uint8_t *value, uint8_t len, uint8_t *affects);
 void calcTempSwitchTriggerValues();
 
 #endif
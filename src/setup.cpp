@@ -8,36 +8,41 @@
 
 #include "setup.h"
 
-#include <EEPROM.h>
 #include "actions.h"
+#include "adc.h"
+#include "history.h"
+#include "loop.h"
+#include "memory.h"
 #include "pcint.h"
+#include "powersave.h"
 #include "rh.h"
+#include "sampling.h"
+#include "scheduler.h"
 #include "settings.h"
 
 void setup () {
 
+  // paint the free memory for the stack usage statistics
+  memoryPaint();
+
   // setup the pins
-  pinMode(VALVE_0_PIN, OUTPUT);
-  pinMode(VALVE_1_PIN, OUTPUT);
-  pinMode(VALVE_2_PIN, OUTPUT);
-  pinMode(VALVE_3_PIN, OUTPUT);
-  pinMode(VALVE_0_BUTTON_PIN, INPUT_PULLUP);
-  pinMode(VALVE_1_BUTTON_PIN, INPUT_PULLUP);
-  pinMode(VALVE_2_BUTTON_PIN, INPUT_PULLUP);
-  pinMode(VALVE_3_BUTTON_PIN, INPUT_PULLUP);
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    pinMode(valvePins[chan], OUTPUT);
+    pinMode(buttonPins[chan], INPUT_PULLUP);
+  }
   pinMode(SENSORS_ACTIVE_PIN, OUTPUT);
   pinMode(LED_PIN, OUTPUT);
   pinMode(EEPROM_RESET_PIN, INPUT_PULLUP);
   pinMode(TEMP_SWITCH_PIN, OUTPUT);
 
   // blink the LED to indicate starting
-  blinkCode(BLINK_LONG);
+  blinkCodeBlocking(BLINK_LONG);
 
   // all channels are off while starting
-  for (uint8_t chan = 0; chan < 4; chan++) {
-    channelOn[chan] = false;
-    channelTurnOn[chan] = false;
-    channelTurnOffTime[chan] = 0;
+  channelOn = 0;
+  channelTurnOn = 0;
+  channelTurnOff = 0;
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
     digitalWrite(valvePins[chan], LOW);
   }
   digitalWrite(SENSORS_ACTIVE_PIN, LOW);
@@ -45,53 +50,61 @@ void setup () {
   pauseAutomatic = false;
 
   // enable PCINT for the buttons
-  attachPCINT(digitalPinToPCINT(VALVE_0_BUTTON_PIN), handlePcintButton0, FALLING);
-  attachPCINT(digitalPinToPCINT(VALVE_1_BUTTON_PIN), handlePcintButton1, FALLING);
-  attachPCINT(digitalPinToPCINT(VALVE_2_BUTTON_PIN), handlePcintButton2, FALLING);
-  attachPCINT(digitalPinToPCINT(VALVE_3_BUTTON_PIN), handlePcintButton3, FALLING);
-
-  // setup the ADC
-  ADMUX =
-    (1 << ADLAR) | // left shift result
-    (0 << REFS1) | // Sets ref. voltage to VCC, bit 1
-    (0 << REFS0) | // Sets ref. voltage to VCC, bit 0
-    (0 << MUX3)  | // use ADC2 as default input, MUX bit 3
-    (0 << MUX2)  | // use ADC2 as default input, MUX bit 2
-    (1 << MUX1)  | // use ADC2 as default input, MUX bit 1
-    (0 << MUX0);   // use ADC2 as default input, MUX bit 0
-  ADCSRA =
-    (1 << ADEN)  | // enable ADC
-    (1 << ADPS2) | // set prescaler to 64, bit 2
-    (1 << ADPS1) | // set prescaler to 64, bit 1
-    (0 << ADPS0);  // set prescaler to 64, bit 0
-
-  // disable ADC for powersaving
-  ADCSRA &= ~(1<<ADEN);
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    attachPCINT(digitalPinToPCINT(buttonPins[chan]), pcintButtonHandler(chan), FALLING);
+  }
+
+  // setup the ADC, the ADC is disabled afterwards for powersaving
+  adcInit();
 
   // disable analog comperator for powersaving
   ACSR |= (1<<ACD);
 
+  // disable unused modules for powersaving
+  powersaveInit();
+
   // need to reset the config?
   if (digitalRead(EEPROM_RESET_PIN) == LOW || EEPROM.read(EEPROM_ADDR_VERSION) != EEPROM_VERSION) {
     // set default config
     loadDefaultSettings();
 
     // save config to eeprom
+    clearSettings();
     saveSettings();
 
+    // clear the history
+    #if HISTORY_ENABLED == 1
+      historyInit(true);
+    #endif
+
     // write the current config data model version to the eeprom
     EEPROM.update(EEPROM_ADDR_VERSION, EEPROM_VERSION);
 
     // blink LED while eeprom reset button is pressed
     while (digitalRead(EEPROM_RESET_PIN) == LOW) {
-      blinkCode(BLINK_SHORT, BLINK_SHORT, BLINK_SHORT);
+      blinkCodeBlocking(BLINK_SHORT, BLINK_SHORT, BLINK_SHORT);
       delay(1000);
     }
   } else {
-    // read config from eeprom
-    loadSettings();
+    // read config from eeprom or use the defaults if there are no valid settings
+    if (!loadSettings()) {
+      loadDefaultSettings();
+      saveSettings();
+    }
+
+    // load the history
+    #if HISTORY_ENABLED == 1
+      historyInit(false);
+    #endif
   }
 
+  // seed the random generator from the own address, so each node gets
+  // different schedule phases and backoff times
+  randomSeed(settings.ownAddress);
+
+  // register the scheduled tasks
+  initTasks();
+
   // init RadioHead
   rhInit();
 
@@ -103,13 +116,25 @@ void setup () {
 
   ds1820.begin();
   ds1820.setResolution(DS1820_RESOLUTION);
+
+  // don't wait for the conversion, the result is collected by a separate task
+  ds1820.setWaitForConversion(false);
+
+  // cache the address of the sensor to avoid searching the bus on each read
+  ds1820AddressValid = ds1820.getAddress(ds1820Address, 0);
 #endif
 
-  // calc adc and temperature sensor next read time, 5/10 seconds from now
+  // calc adc and temperature sensor next read time, 5/10 seconds plus a random phase within the check interval from now
   // temperature sensor read is 5 seconds before adc read to avoid both readings at the same time
-  tempSensorNextReadTime = millis() + 5000;
-  adcNextReadTime = millis() + 10000;
+  unsigned long phase = millis() + random(0, min((uint32_t)samplingCheckInterval() * 1000, (uint32_t)SCHEDULE_JITTER_START));
+  #if TEMP_SENSOR_TYPE != 0
+    schedulerSet(TASK_TEMP_SENSOR, phase + 5000);
+  #endif
+  scheduleAdcRead(phase + 10000);
+  schedulerSet(TASK_RH_POLL, millis());
+  rhListen(millis());
 
-  // send RadioHead start message
+  // send RadioHead start message after a random delay
   rhSendData(RH_MSG_START);
+  schedulerSet(TASK_RH_SEND, millis() + random(0, RH_START_JITTER));
 }
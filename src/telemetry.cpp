@@ -0,0 +1,187 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Automatic push of the current values.
+ *
+ * If settings.pushOnChange is enabled, the values are only pushed if they
+ * differ from the last pushed values by more than the deadband of the
+ * quantity. A heartbeat push is done if nothing was pushed for
+ * settings.heartbeatInterval seconds, so the server can detect a dead node.
+ *
+ * If the duty cycle budget for pushed values is used up, the push is deferred
+ * until a slot of the duty cycle window is dropped. Further pushes in the
+ * meantime are merged, so only the latest values are send.
+ */
+
+#include "telemetry.h"
+
+#include "rh.h"
+#include "scheduler.h"
+
+// last pushed values
+uint16_t telemetryAdcValues[CHANNEL_COUNT];
+#if BAT_ENABLED == 1
+  uint8_t telemetryBattery;
+#endif
+#if TEMP_SENSOR_TYPE != 0
+  int16_t telemetryTemperature;
+  int16_t telemetryHumidity;
+#endif
+
+// quantities which have been pushed at least once
+uint8_t telemetryPushed = 0;
+
+// quantities which are deferred because of the duty cycle limit
+uint8_t telemetryDeferred = 0;
+
+/**
+ * Check if the difference of two values is greater than the deadband.
+ */
+bool telemetryOutside (int16_t value, int16_t last, int16_t deadband) {
+  int16_t diff = value - last;
+  return diff > deadband || diff < -deadband;
+}
+
+/**
+ * Check if the current value of a quantity differs from the last pushed value
+ * by more than its deadband.
+ */
+bool telemetryChanged (uint8_t quantity) {
+  if (!(telemetryPushed & quantity)) {
+    // never pushed before
+    return true;
+  }
+
+  switch (quantity) {
+    case TELEMETRY_SENSORS:
+      if (!settings.sendAdcValuesThroughRH) {
+        return false;
+      }
+      for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+        if ((settings.channelEnabled & CHANNEL_BIT(chan)) && telemetryOutside(adcValues[chan], telemetryAdcValues[chan], settings.deadbandAdc)) {
+          return true;
+        }
+      }
+      return false;
+
+    #if BAT_ENABLED == 1
+      case TELEMETRY_BATTERY:
+        return telemetryOutside(batteryPercent(), telemetryBattery, settings.deadbandBattery);
+    #endif
+
+    #if TEMP_SENSOR_TYPE != 0
+      case TELEMETRY_TEMP:
+        // deadband in tenth of a degree or percent, values in hundredth
+        return telemetryOutside(temperature, telemetryTemperature, settings.deadbandTempTenth * 10)
+          || telemetryOutside(humidity, telemetryHumidity, settings.deadbandTempTenth * 10);
+    #endif
+  }
+
+  return false;
+}
+
+/**
+ * Restart the heartbeat interval.
+ * Must be called after a change of the heartbeat settings.
+ */
+void telemetryRestartHeartbeat () {
+  if (telemetryDeferred) {
+    // the heartbeat task is used to send the deferred push
+    return;
+  }
+  if (settings.pushOnChange && settings.heartbeatInterval > 0) {
+    schedulerSet(TASK_HEARTBEAT, millis() + (uint32_t)settings.heartbeatInterval * 1000);
+  } else {
+    schedulerCancel(TASK_HEARTBEAT);
+  }
+}
+
+/**
+ * Send the values of the quantities and remember them as the last pushed values.
+ */
+void telemetrySend (uint8_t quantities) {
+  if (settings.pushDataEnabled && rhAirtimeLow()) {
+    // defer until the budget is available again
+    telemetryDeferred |= quantities;
+    rhTxDeferred++;
+    schedulerSet(TASK_HEARTBEAT, rhAirtimeFreeAt());
+    return;
+  }
+  quantities |= telemetryDeferred;
+  telemetryDeferred = 0;
+
+  #if RH_PUSH_TELEMETRY == 1
+    // the telemetry message contains all quantities
+    rhSendData(RH_MSG_TELEMETRY);
+    quantities = TELEMETRY_ALL;
+  #else
+    if (quantities & TELEMETRY_SENSORS) {
+      rhSendData(RH_MSG_SENSOR_VALUES);
+    }
+    #if BAT_ENABLED == 1
+      if (quantities & TELEMETRY_BATTERY) {
+        rhSendData(RH_MSG_BATTERY);
+      }
+    #endif
+    if (quantities & TELEMETRY_TEMP) {
+      rhSendData(RH_MSG_TEMP_SENSOR_DATA);
+    }
+  #endif
+
+  if (quantities & TELEMETRY_SENSORS) {
+    memcpy(telemetryAdcValues, adcValues, sizeof(telemetryAdcValues));
+  }
+  #if BAT_ENABLED == 1
+    if (quantities & TELEMETRY_BATTERY) {
+      telemetryBattery = batteryPercent();
+    }
+  #endif
+  #if TEMP_SENSOR_TYPE != 0
+    if (quantities & TELEMETRY_TEMP) {
+      telemetryTemperature = temperature;
+      telemetryHumidity = humidity;
+    }
+  #endif
+  telemetryPushed |= quantities;
+
+  telemetryRestartHeartbeat();
+}
+
+/**
+ * Push the values of the given quantities after they are updated.
+ * If pushing on change is enabled, only the changed quantities are pushed.
+ * @param quantities The updated quantities (TELEMETRY_*).
+ */
+void telemetryPush (uint8_t quantities) {
+  if (settings.pushOnChange) {
+    for (uint8_t quantity = TELEMETRY_SENSORS; quantity <= TELEMETRY_TEMP; quantity <<= 1) {
+      if ((quantities & quantity) && !telemetryChanged(quantity)) {
+        quantities &= ~quantity;
+      }
+    }
+    if (quantities == 0) {
+      // nothing changed
+      return;
+    }
+  }
+
+  telemetrySend(quantities);
+}
+
+/**
+ * Task to push all values if nothing was pushed for the heartbeat interval
+ * or to send the deferred values.
+ */
+void taskHeartbeat (uint8_t task, unsigned long now) {
+  if (telemetryDeferred) {
+    telemetrySend(telemetryDeferred);
+    return;
+  }
+  uint8_t quantities = TELEMETRY_BATTERY | TELEMETRY_TEMP;
+  if (!pauseAutomatic) {
+    quantities |= TELEMETRY_SENSORS;
+  }
+  telemetrySend(quantities);
+}
@@ -0,0 +1,21 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include "globals.h"
+
+// quantities which can be pushed
+#define TELEMETRY_SENSORS 0x01
+#define TELEMETRY_BATTERY 0x02
+#define TELEMETRY_TEMP    0x04
+#define TELEMETRY_ALL     (TELEMETRY_SENSORS | TELEMETRY_BATTERY | TELEMETRY_TEMP)
+
+void telemetryPush (uint8_t quantities);
+void telemetryRestartHeartbeat ();
+void taskHeartbeat (uint8_t task, unsigned long now);
+
+#endif
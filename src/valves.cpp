@@ -0,0 +1,193 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Queue of the channels waiting for watering.
+ *
+ * Channels to turn on are added to the queue and opened by the queue task in
+ * FIFO or driest-first order, as long as less than settings.valveMax valves
+ * are open. After a valve is closed, the next one is opened not before
+ * settings.valveGap seconds have passed.
+ */
+
+#include "valves.h"
+
+#include "actions.h"
+#include "scheduler.h"
+
+// channels in the order they are added
+uint8_t valveQueue[CHANNEL_COUNT];
+uint8_t valveQueueCount = 0;
+volatile ChannelMask valveQueued = 0; // volatile to use this inside a ISR
+
+// no valve is opened until this time if valveGapActive is set
+unsigned long valveGapUntil = 0;
+bool valveGapActive = false;
+
+/**
+ * Get the number of open valves.
+ */
+uint8_t valveOpenCount () {
+  uint8_t count = 0;
+  for (ChannelMask mask = channelOn; mask; mask &= mask - 1) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Get the position of the channel to open next in the queue.
+ */
+uint8_t valveQueueNext (const uint8_t *queue, uint8_t count) {
+  if (settings.valveOrder != VALVE_ORDER_DRIEST) {
+    return 0;
+  }
+
+  // the highest adc value above the trigger value, the first one on a tie
+  uint8_t next = 0;
+  int16_t nextDryness = 0;
+  for (uint8_t pos = 0; pos < count; pos++) {
+    int16_t dryness = (int16_t)adcValues[queue[pos]] - (int16_t)settings.adcTriggerValue[queue[pos]];
+    if (pos == 0 || dryness > nextDryness) {
+      next = pos;
+      nextDryness = dryness;
+    }
+  }
+  return next;
+}
+
+/**
+ * Remove the entry at the given position from a queue.
+ */
+void valveQueueDelete (uint8_t *queue, uint8_t *count, uint8_t pos) {
+  (*count)--;
+  memmove(&queue[pos], &queue[pos + 1], *count - pos);
+}
+
+/**
+ * Add a channel to the queue.
+ * Nothing is done if the channel is already waiting.
+ */
+void valveQueueAdd (uint8_t chan) {
+  if (valveQueued & CHANNEL_BIT(chan)) {
+    return;
+  }
+  valveQueue[valveQueueCount++] = chan;
+  valveQueued |= CHANNEL_BIT(chan);
+  schedulerSet(TASK_VALVE_QUEUE, millis());
+}
+
+/**
+ * Remove a channel from the queue.
+ */
+void valveQueueRemove (uint8_t chan) {
+  for (uint8_t pos = 0; pos < valveQueueCount; pos++) {
+    if (valveQueue[pos] == chan) {
+      valveQueueDelete(valveQueue, &valveQueueCount, pos);
+      valveQueued &= ~CHANNEL_BIT(chan);
+      return;
+    }
+  }
+}
+
+/**
+ * Start the gap after a valve is closed.
+ */
+void valveQueueClosed (unsigned long now) {
+  valveGapUntil = now + (uint32_t)settings.valveGap * 1000;
+  valveGapActive = true;
+  if (valveQueueCount > 0) {
+    schedulerSet(TASK_VALVE_QUEUE, valveGapUntil);
+  }
+}
+
+/**
+ * Get the waiting channels in the order they will be opened.
+ * @param list Array of CHANNEL_COUNT entries for the channels.
+ * @return The number of waiting channels.
+ */
+uint8_t valveQueueList (uint8_t *list) {
+  uint8_t queue[CHANNEL_COUNT];
+  uint8_t count = valveQueueCount;
+  memcpy(queue, valveQueue, count);
+
+  for (uint8_t i = 0; i < valveQueueCount; i++) {
+    uint8_t pos = valveQueueNext(queue, count);
+    list[i] = queue[pos];
+    valveQueueDelete(queue, &count, pos);
+  }
+  return valveQueueCount;
+}
+
+/**
+ * Estimate the time until all waiting channels are watered.
+ * @return The time in seconds.
+ */
+uint16_t valveQueueRemaining (unsigned long now) {
+  uint8_t slots = constrain(settings.valveMax, 1, CHANNEL_COUNT);
+  uint32_t slotFree[CHANNEL_COUNT]; // time in ms from now when the slot can open the next valve
+  uint32_t start = (valveGapActive && !checkTime(now, valveGapUntil)) ? valveGapUntil - now : 0;
+  uint32_t end = 0;
+
+  // slots of the open valves are free after their watering time and the gap
+  uint8_t slot = 0;
+  for (uint8_t chan = 0; chan < CHANNEL_COUNT; chan++) {
+    if (channelOn & CHANNEL_BIT(chan)) {
+      uint32_t off = schedulerIsSet(TASK_VALVE_OFF_0 + chan) ? schedulerGetTime(TASK_VALVE_OFF_0 + chan) - now : 0;
+      end = max(end, off);
+      if (slot < slots) {
+        slotFree[slot++] = off + (uint32_t)settings.valveGap * 1000;
+      }
+    }
+  }
+  for (; slot < slots; slot++) {
+    slotFree[slot] = start;
+  }
+
+  // the waiting channels are opened in the next free slot
+  uint8_t list[CHANNEL_COUNT];
+  uint8_t count = valveQueueList(list);
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t next = 0;
+    for (slot = 1; slot < slots; slot++) {
+      if (slotFree[slot] < slotFree[next]) {
+        next = slot;
+      }
+    }
+    uint32_t off = slotFree[next] + (uint32_t)settings.wateringTime[list[i]] * 1000;
+    end = max(end, off);
+    slotFree[next] = off + (uint32_t)settings.valveGap * 1000;
+  }
+
+  end = (end + 999) / 1000;
+  return (end > 0xFFFF) ? 0xFFFF : end;
+}
+
+/**
+ * Task to open the valves of the waiting channels.
+ */
+void taskValveQueue (uint8_t task, unsigned long now) {
+  if (valveGapActive) {
+    if (!checkTime(now, valveGapUntil)) {
+      schedulerSet(TASK_VALVE_QUEUE, valveGapUntil);
+      return;
+    }
+    valveGapActive = false;
+  }
+
+  while (valveQueueCount > 0 && valveOpenCount() < max(settings.valveMax, 1)) {
+    uint8_t pos = valveQueueNext(valveQueue, valveQueueCount);
+    uint8_t chan = valveQueue[pos];
+    valveQueueDelete(valveQueue, &valveQueueCount, pos);
+    valveQueued &= ~CHANNEL_BIT(chan);
+
+    // the channel may be disabled or turned on while waiting
+    if (!(settings.channelEnabled & CHANNEL_BIT(chan)) || (channelOn & CHANNEL_BIT(chan))) {
+      continue;
+    }
+
+    turnValveOn(chan);
+    schedulerSet(TASK_VALVE_OFF_0 + chan, now + ((uint32_t)settings.wateringTime[chan] * 1000));
+  }
+}
@@ -0,0 +1,25 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ */
+#ifndef __VALVES_H__
+#define __VALVES_H__
+
+#include "globals.h"
+
+// order of the pending watering queue
+#define VALVE_ORDER_FIFO   0 // in the order of the requests
+#define VALVE_ORDER_DRIEST 1 // the channel with the highest adc value above its trigger value first
+
+// channels waiting in the queue
+extern volatile ChannelMask valveQueued;
+
+void valveQueueAdd (uint8_t chan);
+void valveQueueRemove (uint8_t chan);
+void valveQueueClosed (unsigned long now);
+uint8_t valveQueueList (uint8_t *list);
+uint16_t valveQueueRemaining (unsigned long now);
+void taskValveQueue (uint8_t task, unsigned long now);
+
+#endif
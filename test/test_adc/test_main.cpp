@@ -0,0 +1,84 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Tests of the background adc reading on the host.
+ * Run with: pio test -e native
+ */
+
+#include <unity.h>
+
+#include "adc.h"
+#include "loop.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "setup.h"
+
+// state of the settle readings in loop.cpp
+extern ChannelMask sensorsSettleMask;
+
+// adc inputs of the first two channels
+#define MUX_0 (A4 - A0)
+#define MUX_1 (A5 - A0)
+
+void setUp () {}
+
+void tearDown () {}
+
+/**
+ * Run one loop pass with a value on channel 1 which never settles.
+ */
+void stepUnsettled () {
+  halAnalogValues[MUX_1] = (millis() * 7) % 1000;
+  halStep();
+}
+
+/**
+ * The adc read at the end of the warmup waits for a running settle reading
+ * instead of mixing its conversion into the first channel.
+ */
+void testReadWaitsForSettle () {
+  settings.channelEnabled = CHANNEL_BIT(0) | CHANNEL_BIT(1);
+  halAnalogValues[MUX_0] = 100;
+
+  // wait until channel 0 is settled and only channel 1 is read while settling
+  unsigned long end = millis() + 120000;
+  while (sensorsSettleMask != CHANNEL_BIT(1) && checkTime(end, millis())) {
+    stepUnsettled();
+  }
+  TEST_ASSERT_EQUAL_UINT16(CHANNEL_BIT(1), sensorsSettleMask);
+
+  // keep the next settle reading of channel 1 running until the warmup ends
+  halAdcHold = true;
+  while (!adcBusy()) {
+    stepUnsettled();
+  }
+  end = schedulerGetTime(TASK_ADC_READ) + 5;
+  while (!checkTime(millis(), end)) {
+    halStep();
+  }
+  TEST_ASSERT_TRUE(adcBusy());
+
+  halAnalogValues[MUX_1] = 600;
+  halAdcHold = false;
+  end = millis() + 100;
+  while (checkTime(end, millis())) {
+    halStep();
+  }
+
+  TEST_ASSERT_FALSE(adcBusy());
+  TEST_ASSERT_EQUAL_UINT16(0, sensorsSettleMask);
+  TEST_ASSERT_EQUAL_UINT16(100, adcValues[0]);
+  TEST_ASSERT_EQUAL_UINT16(600, adcValues[1]);
+}
+
+int main (int argc, char **argv) {
+  // unprogrammed eeprom
+  memset(halEeprom, 0xFF, sizeof(halEeprom));
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(testReadWaitsForSettle);
+  return UNITY_END();
+}
@@ -0,0 +1,120 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Tests of the LED blink codes on the host.
+ *
+ * The firmware runs on the virtual clock, which only advances between the
+ * loop passes or if the firmware waits, so the time of a pass shows if
+ * something blocks the loop.
+ * Run with: pio test -e native
+ */
+
+#include <unity.h>
+
+#include "actions.h"
+#include "loop.h"
+#include "rh.h"
+#include "settings.h"
+#include "setup.h"
+
+// number of times the LED was turned on while running the loop
+uint8_t blinks;
+bool ledOn;
+
+// id of the next injected radio message
+uint8_t injectId = 0;
+
+void setUp () {
+  blinks = 0;
+  ledOn = digitalRead(LED_PIN);
+}
+
+void tearDown () {}
+
+/**
+ * Acknowledge all frames send by the node like the server, so no send errors
+ * are blinked.
+ */
+void serve () {
+  HalRadioFrame frame;
+  while (halRadioTake(&frame)) {
+    if (!(frame.flags & RH_FLAGS_ACK) && frame.to != RH_BROADCAST_ADDRESS) {
+      uint8_t ack = '!';
+      halRadioInject(frame.to, frame.from, frame.id, RH_FLAGS_ACK, &ack, sizeof(ack));
+    }
+  }
+}
+
+/**
+ * Run the loop for the given time and count the times the LED is turned on.
+ */
+void runLoop (unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (checkTime(end, millis())) {
+    halStep();
+    serve();
+    if (digitalRead(LED_PIN) && !ledOn) {
+      blinks++;
+    }
+    ledOn = digitalRead(LED_PIN);
+  }
+}
+
+/**
+ * Let the node receive a message from the server, which queues a blink code
+ * inside a loop pass.
+ */
+void receiveMessage () {
+  uint8_t msg = RH_MSG_GET_VERSION;
+  halRadioInject(settings.serverAddress, settings.ownAddress, injectId++, RH_FLAGS_NONE, &msg, 1);
+  runLoop(RH_POLL_INTERVAL * 2);
+}
+
+/**
+ * The worst loop pass doesn't grow with queued blink codes.
+ */
+void testBlinkDoesNotStall () {
+  // let the system start up and measure the passes without blink codes
+  runLoop(30000);
+  loopPassMax = 0;
+  runLoop(10000);
+  uint32_t passMaxIdle = loopPassMax;
+
+  // fill the blink queue from within the loop
+  loopPassMax = 0;
+  blinks = 0;
+  for (uint8_t i = 0; i < BLINK_QUEUE_LEN; i++) {
+    receiveMessage();
+  }
+  runLoop(10000);
+
+  // all blinks are shown, no pass took longer than without blinking and not even as long as one blink
+  TEST_ASSERT_EQUAL_UINT8(BLINK_QUEUE_LEN * 2, blinks);
+  TEST_ASSERT_FALSE(digitalRead(LED_PIN));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(passMaxIdle, loopPassMax);
+  TEST_ASSERT_LESS_THAN_UINT32(BLINK_VERY_SHORT * 1000UL, loopPassMax);
+}
+
+/**
+ * Blink codes exceeding the queue are dropped.
+ */
+void testBlinkQueueFull () {
+  for (uint8_t i = 0; i < BLINK_QUEUE_LEN + 2; i++) {
+    blinkCode(BLINK_SHORT);
+  }
+  runLoop(10000);
+  TEST_ASSERT_EQUAL_UINT8(BLINK_QUEUE_LEN, blinks);
+}
+
+int main (int argc, char **argv) {
+  // unprogrammed eeprom
+  memset(halEeprom, 0xFF, sizeof(halEeprom));
+  setup();
+
+  UNITY_BEGIN();
+  RUN_TEST(testBlinkDoesNotStall);
+  RUN_TEST(testBlinkQueueFull);
+  return UNITY_END();
+}
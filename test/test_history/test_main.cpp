@@ -0,0 +1,114 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Tests of the history download on the host.
+ * Run with: pio test -e native
+ */
+
+#include <unity.h>
+
+#include "history.h"
+#include "loop.h"
+#include "rh.h"
+#include "settings.h"
+#include "setup.h"
+
+// header of the last history chunk send by the node
+uint16_t chunkSeq;
+uint8_t chunkCount;
+
+void setUp () {
+  chunkSeq = HISTORY_SEQ_EMPTY;
+  chunkCount = 0xFF;
+}
+
+void tearDown () {}
+
+/**
+ * Run the loop until the queued messages are send, keep the header of the
+ * last history chunk and acknowledge all frames like the server.
+ */
+void runLoop (unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (checkTime(end, millis())) {
+    halStep();
+
+    HalRadioFrame frame;
+    while (halRadioTake(&frame)) {
+      if (frame.flags & RH_FLAGS_ACK) {
+        continue;
+      }
+      if (frame.data[RH_ROUTE_HEADER_LEN] == RH_MSG_HISTORY) {
+        memcpy(&chunkSeq, &frame.data[RH_ROUTE_HEADER_LEN + 1], 2);
+        chunkCount = frame.data[RH_ROUTE_HEADER_LEN + 3] & ~HISTORY_CHUNK_MORE;
+      }
+      uint8_t ack = '!';
+      halRadioInject(frame.to, frame.from, frame.id, RH_FLAGS_ACK, &ack, sizeof(ack));
+    }
+  }
+}
+
+/**
+ * Request the history from the given sequence number and wait for the reply.
+ */
+void request (uint16_t seq) {
+  historySend(seq, 1, settings.serverAddress);
+  runLoop(1000);
+}
+
+/**
+ * A request for the next sample returns an empty chunk.
+ */
+void testRequestNewest () {
+  historyInit(true);
+  historyInit(false);
+  for (uint8_t i = 0; i < 3; i++) {
+    historyAdd();
+  }
+
+  request(3);
+  TEST_ASSERT_EQUAL_UINT16(3, chunkSeq);
+  TEST_ASSERT_EQUAL_UINT8(0, chunkCount);
+
+  request(1);
+  TEST_ASSERT_EQUAL_UINT16(1, chunkSeq);
+  TEST_ASSERT_EQUAL_UINT8(2, chunkCount);
+}
+
+/**
+ * A request ahead of the newest sample, like from a server which saw the
+ * samples before a restart, gets the samples added since the restart.
+ */
+void testRequestAheadAfterRestart () {
+  historyInit(true);
+  historyInit(false);
+  for (uint8_t i = 0; i < 8; i++) {
+    historyAdd();
+  }
+
+  // restart with the history in SRAM
+  historyInit(false);
+  historyAdd();
+  historyAdd();
+
+  request(8);
+  TEST_ASSERT_EQUAL_UINT16(0, chunkSeq);
+  TEST_ASSERT_EQUAL_UINT8(2, chunkCount);
+}
+
+int main (int argc, char **argv) {
+  // unprogrammed eeprom
+  memset(halEeprom, 0xFF, sizeof(halEeprom));
+  setup();
+  // let the first check pass, the next one is not due while testing
+  runLoop(60000);
+
+  UNITY_BEGIN();
+  RUN_TEST(testRequestNewest);
+  #if HISTORY_EEPROM == 0
+    RUN_TEST(testRequestAheadAfterRestart);
+  #endif
+  return UNITY_END();
+}
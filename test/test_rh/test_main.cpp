@@ -0,0 +1,171 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Tests of the RadioHead message handling on the host.
+ * Run with: pio test -e native
+ */
+
+#include <unity.h>
+
+#include "rh.h"
+#include "sampling.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "setup.h"
+
+// another node sending to this node
+#define OTHER_ADDR 0x20
+
+// number of version replies send by the node
+uint8_t versionReplies;
+// last message send by the node without the route header
+uint8_t lastMsg[HAL_RADIO_MAX_LEN];
+uint8_t lastMsgLen = 0;
+
+void setUp () {
+  versionReplies = 0;
+}
+
+void tearDown () {}
+
+/**
+ * Run the loop for the given time, count the version replies and acknowledge
+ * all frames like the server.
+ */
+void runLoop (unsigned long ms) {
+  unsigned long end = millis() + ms;
+  while (checkTime(end, millis())) {
+    halStep();
+
+    HalRadioFrame frame;
+    while (halRadioTake(&frame)) {
+      if (frame.flags & RH_FLAGS_ACK) {
+        continue;
+      }
+      if (frame.data[RH_ROUTE_HEADER_LEN] == RH_MSG_VERSION) {
+        versionReplies++;
+      }
+      lastMsgLen = frame.len - RH_ROUTE_HEADER_LEN;
+      memcpy(lastMsg, &frame.data[RH_ROUTE_HEADER_LEN], lastMsgLen);
+      uint8_t ack = '!';
+      halRadioInject(frame.to, frame.from, frame.id, RH_FLAGS_ACK, &ack, sizeof(ack));
+    }
+  }
+}
+
+/**
+ * Let the node receive a message and run the loop for the given time.
+ */
+void receive (uint8_t from, uint8_t id, const uint8_t *data, uint8_t len, unsigned long ms) {
+  uint8_t msg[HAL_RADIO_MAX_LEN];
+  #if RH_ROUTING == 1
+    msg[0] = settings.ownAddress;
+    msg[1] = from;
+    msg[2] = 0;
+    msg[3] = id;
+    msg[4] = 0;
+  #endif
+  memcpy(&msg[RH_ROUTE_HEADER_LEN], data, len);
+  halRadioInject(from, settings.ownAddress, id, RH_FLAGS_NONE, msg, RH_ROUTE_HEADER_LEN + len);
+  runLoop(ms);
+}
+
+/**
+ * Let the node receive a version request.
+ */
+void receiveGetVersion (uint8_t from, uint8_t id) {
+  uint8_t msg = RH_MSG_GET_VERSION;
+  receive(from, id, &msg, 1, 1000);
+}
+
+/**
+ * Retransmissions are detected per sender, even if the senders alternate.
+ */
+void testRetransmissionAlternatingSenders () {
+  receiveGetVersion(settings.serverAddress, 7);
+  receiveGetVersion(OTHER_ADDR, 7);
+  receiveGetVersion(settings.serverAddress, 7);
+  receiveGetVersion(OTHER_ADDR, 7);
+  TEST_ASSERT_EQUAL_UINT8(2, versionReplies);
+
+  // new ids are handled
+  receiveGetVersion(OTHER_ADDR, 8);
+  receiveGetVersion(settings.serverAddress, 8);
+  TEST_ASSERT_EQUAL_UINT8(4, versionReplies);
+}
+
+/**
+ * The oldest sender is forgotten if more senders than RH_RX_SEEN_LEN send.
+ */
+void testRetransmissionManySenders () {
+  for (uint8_t i = 0; i < RH_RX_SEEN_LEN; i++) {
+    receiveGetVersion(OTHER_ADDR + 1 + i, 1);
+  }
+  for (uint8_t i = 0; i < RH_RX_SEEN_LEN; i++) {
+    receiveGetVersion(OTHER_ADDR + 1 + i, 1);
+  }
+  TEST_ASSERT_EQUAL_UINT8(RH_RX_SEEN_LEN, versionReplies);
+}
+
+/**
+ * Setting the same extended settings again doesn't restart the timers.
+ */
+void testSetExtSettingsUnchanged () {
+  // make sure the next check is not due while handling the messages
+  if (schedulerGetTime(TASK_ADC_READ) - millis() < 5000) {
+    runLoop(6000);
+  }
+  unsigned long adcReadTime = schedulerGetTime(TASK_ADC_READ);
+
+  uint8_t msg = RH_MSG_GET_EXT_SETTINGS;
+  receive(settings.serverAddress, 20, &msg, 1, 1000);
+  TEST_ASSERT_EQUAL_UINT8(RH_MSG_EXT_SETTINGS, lastMsg[0]);
+
+  // send the received settings back
+  uint8_t extSettings[HAL_RADIO_MAX_LEN];
+  uint8_t len = lastMsgLen;
+  memcpy(extSettings, lastMsg, len);
+  extSettings[0] = RH_MSG_SET_EXT_SETTINGS;
+  receive(settings.serverAddress, 21, extSettings, len, 1000);
+  TEST_ASSERT_EQUAL_UINT32(adcReadTime, schedulerGetTime(TASK_ADC_READ));
+
+  // a changed check interval is applied
+  extSettings[14] = 0x01;
+  receive(settings.serverAddress, 22, extSettings, len, 1000);
+  TEST_ASSERT_TRUE(settings.checkAdaptive);
+  TEST_ASSERT_TRUE(adcReadTime != schedulerGetTime(TASK_ADC_READ));
+}
+
+/**
+ * A short extended settings frame sets only the leading fields.
+ */
+void testSetExtSettingsShort () {
+  uint16_t heartbeat = settings.heartbeatInterval;
+  uint8_t msg[] = { RH_MSG_SET_EXT_SETTINGS, 2, ADC_FILTER_MEDIAN, 5, 0x01, 20, 5, 2, 0x10 };
+
+  // oversampling only
+  receive(settings.serverAddress, 30, msg, 2, 1000);
+  TEST_ASSERT_EQUAL_UINT8(2, settings.adcOversampling);
+
+  // up to the incomplete heartbeat interval
+  receive(settings.serverAddress, 31, msg, sizeof(msg), 1000);
+  TEST_ASSERT_EQUAL_UINT8(ADC_FILTER_MEDIAN, settings.adcFilterType);
+  TEST_ASSERT_EQUAL_UINT8(2, settings.deadbandBattery);
+  TEST_ASSERT_EQUAL_UINT16(heartbeat, settings.heartbeatInterval);
+}
+
+int main (int argc, char **argv) {
+  // unprogrammed eeprom
+  memset(halEeprom, 0xFF, sizeof(halEeprom));
+  setup();
+  runLoop(30000);
+
+  UNITY_BEGIN();
+  RUN_TEST(testRetransmissionAlternatingSenders);
+  RUN_TEST(testRetransmissionManySenders);
+  RUN_TEST(testSetExtSettingsUnchanged);
+  RUN_TEST(testSetExtSettingsShort);
+  return UNITY_END();
+}
@@ -0,0 +1,205 @@
+/*
+ * Automatic Watering System
+ *
+ * (c) 2018-2021 Peter Müller <peter@crycode.de> (https://crycode.de)
+ *
+ * Tests of the task scheduler on the host.
+ *
+ * The scheduler gets the current time passed in, so the tests drive it with
+ * a fake time instead of the virtual clock.
+ * Run with: pio test -e native
+ */
+
+#include <unity.h>
+
+#include "scheduler.h"
+
+// tasks in the order they have run
+uint8_t runOrder[SCHEDULER_TASK_COUNT * 2];
+uint8_t runCount;
+
+// time to reschedule the task to from within the callback, 0 for none
+unsigned long rescheduleTime;
+
+void testTask (uint8_t task, unsigned long now) {
+  if (runCount < sizeof(runOrder)) {
+    runOrder[runCount] = task;
+  }
+  runCount++;
+
+  if (rescheduleTime != 0) {
+    schedulerSet(task, rescheduleTime);
+  }
+}
+
+void setUp () {
+  for (uint8_t task = 0; task < SCHEDULER_TASK_COUNT; task++) {
+    schedulerCancel(task);
+    schedulerAdd(task, testTask);
+    schedulerMaxLateness[task] = 0;
+    schedulerMaxRunTime[task] = 0;
+  }
+  runCount = 0;
+  rescheduleTime = 0;
+}
+
+void tearDown () {}
+
+/**
+ * The tasks run in the order of their deadlines, not in the order they are set.
+ */
+void testDeadlineOrder () {
+  schedulerSet(2, 300);
+  schedulerSet(0, 100);
+  schedulerSet(1, 200);
+
+  TEST_ASSERT_EQUAL_UINT32(100, schedulerIdleTime(0));
+  TEST_ASSERT_TRUE(schedulerRun(1000) != SCHEDULER_END);
+
+  const uint8_t expected[] = { 0, 1, 2 };
+  TEST_ASSERT_EQUAL_UINT8(3, runCount);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, runOrder, 3);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, schedulerIdleTime(1000));
+}
+
+/**
+ * Tasks with the same deadline run in the order they are set.
+ */
+void testSameDeadline () {
+  schedulerSet(3, 100);
+  schedulerSet(1, 100);
+  schedulerSet(2, 100);
+
+  schedulerRun(100);
+
+  const uint8_t expected[] = { 3, 1, 2 };
+  TEST_ASSERT_EQUAL_UINT8(3, runCount);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, runOrder, 3);
+}
+
+/**
+ * Only the due tasks run.
+ */
+void testNotDue () {
+  schedulerSet(0, 100);
+  schedulerSet(1, 200);
+
+  TEST_ASSERT_EQUAL_UINT8(SCHEDULER_END, schedulerRun(99));
+  TEST_ASSERT_EQUAL_UINT8(0, runCount);
+  TEST_ASSERT_EQUAL_UINT32(1, schedulerIdleTime(99));
+
+  schedulerRun(150);
+  TEST_ASSERT_EQUAL_UINT8(1, runCount);
+  TEST_ASSERT_EQUAL_UINT8(0, runOrder[0]);
+  TEST_ASSERT_FALSE(schedulerIsSet(0));
+  TEST_ASSERT_TRUE(schedulerIsSet(1));
+  TEST_ASSERT_EQUAL_UINT32(50, schedulerIdleTime(150));
+}
+
+/**
+ * Setting an already scheduled task moves it to the new time.
+ */
+void testRearm () {
+  schedulerSet(0, 100);
+  schedulerSet(1, 200);
+  schedulerSet(0, 300);
+
+  TEST_ASSERT_EQUAL_UINT32(300, schedulerGetTime(0));
+  schedulerRun(250);
+  TEST_ASSERT_EQUAL_UINT8(1, runCount);
+  TEST_ASSERT_EQUAL_UINT8(1, runOrder[0]);
+
+  schedulerRun(300);
+  TEST_ASSERT_EQUAL_UINT8(2, runCount);
+  TEST_ASSERT_EQUAL_UINT8(0, runOrder[1]);
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, schedulerIdleTime(300));
+}
+
+/**
+ * A task may reschedule itself, but runs at most once per call even if the
+ * new time is already due.
+ */
+void testRearmFromTask () {
+  schedulerSet(0, 100);
+  rescheduleTime = 50;
+
+  schedulerRun(100);
+  TEST_ASSERT_EQUAL_UINT8(1, runCount);
+  TEST_ASSERT_TRUE(schedulerIsSet(0));
+  TEST_ASSERT_EQUAL_UINT32(0, schedulerIdleTime(100));
+
+  rescheduleTime = 0;
+  schedulerRun(100);
+  TEST_ASSERT_EQUAL_UINT8(2, runCount);
+  TEST_ASSERT_FALSE(schedulerIsSet(0));
+}
+
+/**
+ * Cancelled tasks don't run, no matter where they are in the list.
+ */
+void testCancel () {
+  schedulerSet(0, 100);
+  schedulerSet(1, 200);
+  schedulerSet(2, 300);
+
+  // middle and head of the list
+  schedulerCancel(1);
+  schedulerCancel(0);
+  // not scheduled anymore
+  schedulerCancel(0);
+
+  TEST_ASSERT_FALSE(schedulerIsSet(0));
+  TEST_ASSERT_FALSE(schedulerIsSet(1));
+  TEST_ASSERT_EQUAL_UINT32(300, schedulerIdleTime(0));
+
+  schedulerRun(1000);
+  TEST_ASSERT_EQUAL_UINT8(1, runCount);
+  TEST_ASSERT_EQUAL_UINT8(2, runOrder[0]);
+}
+
+/**
+ * The deadlines and the lateness are correct when the time wraps around.
+ */
+void testLatenessWrapAround () {
+  // 16 ms before the time wraps around
+  const unsigned long beforeWrap = (unsigned long)0 - 16;
+
+  schedulerSet(1, beforeWrap + 32);
+  schedulerSet(0, beforeWrap);
+
+  // the task before the wrap-around is the first one
+  TEST_ASSERT_EQUAL_UINT32(16, schedulerIdleTime(beforeWrap - 16));
+  schedulerRun(beforeWrap);
+  TEST_ASSERT_EQUAL_UINT8(1, runCount);
+  TEST_ASSERT_EQUAL_UINT8(0, runOrder[0]);
+  TEST_ASSERT_EQUAL_UINT32(32, schedulerIdleTime(beforeWrap));
+
+  // run 20 ms late after the wrap-around
+  schedulerRun(beforeWrap + 52);
+  TEST_ASSERT_EQUAL_UINT8(2, runCount);
+  TEST_ASSERT_EQUAL_UINT8(1, runOrder[1]);
+  TEST_ASSERT_EQUAL_UINT16(20, schedulerMaxLateness[1]);
+  TEST_ASSERT_EQUAL_UINT16(0, schedulerMaxLateness[0]);
+}
+
+/**
+ * The lateness is limited to the max value of the statistics.
+ */
+void testLatenessLimit () {
+  schedulerSet(0, 100);
+  schedulerRun(100 + 100000UL);
+  TEST_ASSERT_EQUAL_UINT16(0xFFFF, schedulerMaxLateness[0]);
+}
+
+int main (int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(testDeadlineOrder);
+  RUN_TEST(testSameDeadline);
+  RUN_TEST(testNotDue);
+  RUN_TEST(testRearm);
+  RUN_TEST(testRearmFromTask);
+  RUN_TEST(testCancel);
+  RUN_TEST(testLatenessWrapAround);
+  RUN_TEST(testLatenessLimit);
+  return UNITY_END();
+}